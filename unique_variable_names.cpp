@@ -2,6 +2,9 @@
 
 // This is a program to evaluate similarity of names of user defined language constructs.
 
+// The similarity of two names is by default the length of their longest common subsequence
+// over the length of the longer name; --metric selects other metrics (see Metric), such as:
+
 // Ratcliff/Obershelp pattern recognition:
 // The Ratcliff/Obershelp algorithm computes the similarity of two strings as the doubled 
 // number of matching characters divided by the total number of characters in the two strings. 
@@ -12,14 +15,289 @@
 
 #include "rose.h"
 
-#define DEBUG 0
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <limits.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
 
-using namespace std;
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <map>
+#include <set>
 
-#define MAX_LCS 256 ///< Maximum size of the longest common sequence
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
 
+/**
+ * Pairs of names more similar than this are reported (see PruningBounds).
+ */
 float similarity_threshold = 0.75;
 
+/**
+ * Also count the matches more than each of these thresholds (in ascending
+ * order), all found by scoring once at the lowest of them (see
+ * RunStatistics::thresholdMatches).
+ */
+vector<float> threshold_bins;
+
+/**
+ * Names of fewer characters are left out of the comparison.
+ */
+unsigned min_name_length = 0;
+
+/**
+ * When set, each scope only compares pairs of names that were not already
+ * compared in a nested scope (see NameStructure::group), so that
+ * every pair is evaluated, and every match reported, exactly once.
+ */
+bool incremental_mode = false;
+
+/**
+ * Number of threads scoring the pairs of names of large scopes.
+ */
+unsigned number_of_threads = 1;
+
+/**
+ * Bound (in bytes, none if 0) on the matches and the scores held while
+ * scoring: beyond half of it the matches spill to sorted runs in a
+ * temporary file, merged back as they are reported (see MatchSpill), and
+ * the ScoreMemo stops growing at a quarter of it.
+ */
+size_t memory_budget = 0;
+
+/**
+ * Report one of the longest common subsequences of each pair of matching
+ * names (these are only reconstructed when asked for).
+ */
+bool show_lcs = false;
+
+/**
+ * Only traverse the input files themselves, not the headers they include.
+ */
+bool input_files_only = false;
+
+/**
+ * Leave the names declared in system headers (see isSystemHeader()), and in
+ * any file under one of the excluded_paths, out of the comparison entirely.
+ */
+bool exclude_system_headers = false;
+vector<string> excluded_paths;
+
+/**
+ * Compute the matches of each scope located in a header once, and reuse them
+ * for every other translation unit including the same version of the header.
+ */
+bool cache_headers = false;
+
+/**
+ * The persistent index of the input files (see SimilarityIndex), none if empty.
+ */
+string index_file;
+
+/**
+ * Only build (and visit) as much of the AST as the names need: skip the
+ * comments and preprocessor directives, and the expressions.
+ */
+bool fast_extraction = false;
+
+/**
+ * Write the names extracted from the AST to emit_names_file instead of
+ * scoring them, or score the names of the name_stream_files instead of
+ * running the frontend (see NameStream).
+ */
+string emit_names_file;
+vector<string> name_stream_files;
+
+/**
+ * Parse the input files one at a time, each in a project of its own, while
+ * the names of the previous ones are scored and reported (see runPipeline()).
+ */
+bool pipeline_mode = false;
+
+/**
+ * The phase of a sharded comparison of all the names of the --names
+ * streams as a single scope (see ShardTable): planning the table and its
+ * blocks (of pairs of shard_chunks chunks), scoring one block, or merging
+ * the scores of all of them into the report.
+ */
+enum ShardPhase { NoShards, PlanShards, ScoreShard, MergeShards };
+
+ShardPhase shard_phase = NoShards;
+string     shard_table;
+unsigned   shard_block  = 0;
+unsigned   shard_chunks = 16;
+
+/**
+ * The pairs of names of the scopes with more than LshIndex::MinCandidates
+ * distinct names are only scored if locality-sensitive hashing finds them
+ * as candidates (see LshIndex), by lsh_bands bands of lsh_rows MinHash
+ * values each.  With no bands (the default) every pair is scored.
+ */
+unsigned lsh_bands = 0;
+unsigned lsh_rows  = 3;
+
+/**
+ * Report the pairs of names of a scope that only differ in case,
+ * underscores and digits (see canonicalName()) as matches, without scoring
+ * them and whatever their similarity.
+ */
+bool canonical_mode = false;
+
+/**
+ * The format of the report: the original text, one JSON object per match
+ * (JSON lines), or a SARIF log; and the file it is written to (standard
+ * output if empty).  See ReportWriter.
+ */
+enum ReportFormat { TextReport, JsonLinesReport, SarifReport };
+
+ReportFormat report_format = TextReport;
+string       output_file;
+
+/**
+ * Collect the cost of each scope, and print a summary of the run (to
+ * standard error) with the scopes that took the longest (see
+ * RunStatistics); and the file to write all of them to, if any.  The
+ * totals are counted either way.
+ */
+bool   stats_mode = false;
+string stats_file;
+
+/**
+ * Print the names as they are collected (above 3) and the matches as they
+ * are found (above 1), to standard error.
+ */
+unsigned debug_level = 0;
+
+/**
+ * Run the benchmarks instead of the comparison (see runBenchmarks()),
+ * comparing them to the benchmark_baseline file if given; the synthetic
+ * scope tree has benchmark_depth levels of benchmark_breadth scopes.
+ */
+bool     benchmark_mode    = false;
+string   benchmark_baseline;
+unsigned benchmark_depth   = 3;
+unsigned benchmark_breadth = 4;
+
+/**
+ * Answer the queries read from standard input about the names of this
+ * SimilarityIndex instead of running the comparison (see runQueries()).
+ */
+string query_index;
+
+/**
+ * \return true if fileName is where a compiler (or ROSE) keeps its headers.
+ */
+bool
+isSystemHeader(const string& fileName)
+  {
+    static const char* systemPaths[] =
+      {
+        "/usr/include/",
+        "/usr/local/include/",
+        "/usr/lib/gcc/",
+        "/usr/lib64/gcc/",
+        NULL
+      };
+
+    for (size_t i = 0; systemPaths[i] != NULL; ++i)
+      {
+        if (fileName.compare(0, strlen(systemPaths[i]), systemPaths[i]) == 0)
+            return true;
+      }
+
+ // The copies of the compiler's headers set up when ROSE is installed.
+    return fileName.find("/include-staging/") != string::npos;
+  }
+
+/**
+ * \return the 64-bit FNV-1a hash of size bytes, continuing from hash.
+ */
+uint64_t
+hashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull)
+  {
+    const unsigned char* bytes = (const unsigned char*) data;
+    for (size_t i = 0; i < size; ++i)
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    return hash;
+  }
+
+/**
+ * \return the bits of value mixed (by the finalizer of SplitMix64).
+ */
+uint64_t
+mixBits(uint64_t value)
+  {
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+    return value ^ (value >> 31);
+  }
+
+/**
+ * \return the time in seconds since some fixed point in the past.
+ */
+double
+secondsNow()
+  {
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + 1e-9 * time.tv_nsec;
+  }
+
+/**
+ * \return name in lower case, without its underscores and digits: the names
+ * with the same canonical name are trivial variants of each other, such as
+ * buffer_, _buffer, Buffer and buffer2.
+ */
+string
+canonicalName(const char* name, size_t length)
+  {
+    string result;
+    result.reserve(length);
+
+    for (size_t i = 0; i < length; ++i)
+      {
+        unsigned char c = name[i];
+        if (c != '_' && isdigit(c) == 0)
+            result += (char) tolower(c);
+      }
+
+    return result;
+  }
+
+/**
+ * \return the hash of the contents of the file, or 0 if it can't be read.
+ */
+uint64_t
+hashFileContents(const string& fileName)
+  {
+    FILE* file = fopen(fileName.c_str(), "rb");
+    if (file == NULL)
+        return 0;
+
+    uint64_t hash = hashBytes(NULL, 0);
+
+    char buffer[64 * 1024];
+    size_t size;
+    while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        hash = hashBytes(buffer, size, hash);
+
+    fclose(file);
+    return hash;
+  }
+
 /**
  * Quick and dirty swap of the address of 2 arrays
  * of `unsigned int`.
@@ -34,503 +312,8423 @@ swap(unsigned** first, unsigned** second)
   }
 
 /**
- * \return percent similarity of two strings
- *
- * Assumes that both strings point to two valid, null-terminated
- * char arrays.
+ * Candidate names packed for the batched comparisons of SimilarityKernel.
  *
- * Note that the order of the strings is significant.
+ * Candidates are stored in groups of Lanes names, structure of arrays:
+ * character t of the candidate in lane k of a group is at
+ * characters[groupOffset + t * Lanes + k].  Each group is as long as its
+ * longest name, shorter names (and the unused lanes of the last group)
+ * being padded with NUL characters, which never match.
  *
- * For example,
+ * Usage: clear(), add() each candidate, then pack() before scoring.
+ */
+class CandidateBlock
+  {
+    public:
+      static const size_t Lanes = 8;
+
+      void clear();
+      void add(const char* name, uint32_t length);
+      void pack();
+
+      size_t size() const { return names.size(); }
+      const char* name(size_t k) const { return names[k]; }
+      uint32_t length(size_t k) const { return lengths[k]; }
+
+      size_t groupLength(size_t g) const { return groupLengths[g]; }
+      const unsigned char* groupCharacters(size_t g) const { return &characters[groupOffsets[g]]; }
+
+    private:
+      vector<const char*>   names;
+      vector<uint32_t>      lengths;
+
+      vector<uint32_t>      groupLengths;
+      vector<size_t>        groupOffsets;
+      vector<unsigned char> characters;
+  };
+
+const size_t CandidateBlock::Lanes;
+
+void
+CandidateBlock::clear()
+  {
+    names.clear();
+    lengths.clear();
+  }
+
+void
+CandidateBlock::add(const char* name, uint32_t length)
+  {
+    names.push_back(name);
+    lengths.push_back(length);
+  }
+
+void
+CandidateBlock::pack()
+  {
+    size_t groups = (names.size() + Lanes - 1) / Lanes;
+
+    groupLengths.assign(groups, 0);
+    groupOffsets.resize(groups);
+
+    size_t offset = 0;
+    for (size_t g = 0; g < groups; ++g)
+      {
+        for (size_t k = g * Lanes; k < names.size() && k < (g + 1) * Lanes; ++k)
+            groupLengths[g] = max(groupLengths[g], lengths[k]);
+
+        groupOffsets[g] = offset;
+        offset += groupLengths[g] * Lanes;
+      }
+
+    characters.assign(offset, 0);
+
+    for (size_t k = 0; k < names.size(); ++k)
+      {
+        unsigned char* column = &characters[groupOffsets[k / Lanes]] + k % Lanes;
+        for (uint32_t t = 0; t < lengths[k]; ++t)
+            column[t * Lanes] = (unsigned char) names[k][t];
+      }
+  }
+
+/**
+ * Histogram of the characters of a name, giving a cheap upper bound on the
+ * length of the longest common subsequence of two names: a common
+ * subsequence cannot use more of any character than either name contains.
  *
- *  ("buffer", "fer") = 0.5
- *  ("fer", "buffer") = 1.0
+ * Characters are folded into 64 classes (letters, digits and '_' each have
+ * their own, everything else shares one), which can only loosen the bound.
+ * Counts saturate at 255, so the bound only holds for names of at most
+ * MaxLength characters.
  */
-float
-similarityMetric(const char* strX, const char* strY)
+class NameSignature
   {
-    size_t  lenX = strlen(strX),
-            lenY = strlen(strY);
+    public:
+      static const size_t Classes   = 64;
+      static const size_t MaxLength = 255;
 
-    const char *str1 = (lenX > lenY) ? strX : strY,
-               *str2 = (lenX > lenY) ? strY : strX;
+      void assign(const char* name, size_t length);
 
-    size_t len1 = strlen(str1), len2 = strlen(str2);
+      /**
+       * \return an upper bound on the length of the longest common
+       * subsequence of the two names (if neither exceeds MaxLength)
+       */
+      unsigned commonCharacters(const NameSignature& other) const;
 
-    ROSE_ASSERT(len1 >= len2);
+      uint8_t counts[Classes];
+  };
 
-    float lenLCS;
-    unsigned j, k, *previous, *next;
+const size_t NameSignature::Classes;
+const size_t NameSignature::MaxLength;
 
-    if (len1 == 0 || len2 == 0)
-        return 0.0;
+void
+NameSignature::assign(const char* name, size_t length)
+  {
+    memset(counts, 0, sizeof(counts));
 
-    previous = (unsigned *) calloc( len1+1, sizeof(unsigned));
-    next     = (unsigned *) calloc( len1+1, sizeof(unsigned));
+    for (size_t k = 0; k < length; ++k)
+      {
+        unsigned char c = (unsigned char) name[k];
+        size_t characterClass;
 
-    for(j=0; j<len2; ++j)
+        if (c >= 'a' && c <= 'z')
+            characterClass = c - 'a';
+          else if (c >= 'A' && c <= 'Z')
+            characterClass = 26 + (c - 'A');
+          else if (c >= '0' && c <= '9')
+            characterClass = 52 + (c - '0');
+          else if (c == '_')
+            characterClass = 62;
+          else
+            characterClass = 63;
+
+        if (counts[characterClass] < 255)
+            ++counts[characterClass];
+      }
+  }
+
+unsigned
+NameSignature::commonCharacters(const NameSignature& other) const
+  {
+#if defined(__SSE2__)
+    __m128i zero = _mm_setzero_si128();
+    __m128i sum  = zero;
+    for (size_t k = 0; k < Classes; k += 16)
       {
-        for(k=1; k<=len1; ++k)
-             if( str1[k-1] == str2[j])
-                  next[k]=previous[k-1]+1;
-               else
-                  next[k] = previous[k] >= next[k-1] ? previous[k] : next[k-1];
+        __m128i common = _mm_min_epu8(_mm_loadu_si128((const __m128i*) (counts + k)),
+                                      _mm_loadu_si128((const __m128i*) (other.counts + k)));
+        sum = _mm_add_epi64(sum, _mm_sad_epu8(common, zero));
+      }
+    return (unsigned) (_mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8)));
+#else
+    unsigned common = 0;
+    for (size_t k = 0; k < Classes; ++k)
+        common += min(counts[k], other.counts[k]);
+    return common;
+#endif
+  }
 
-     // Note that this as a function might eliminate oportunities for optimization.
-        swap( &previous, &next);
+/**
+ * The bounds of the similarity_metric at the similarity_threshold that the
+ * scoring prunes the pairs of names by, precomputed as integers for the
+ * names of up to MaxLength characters once the options are known (see
+ * compute()), so that the pruning compares lengths and counts instead of
+ * dividing them.
+ */
+class PruningBounds
+  {
+    public:
+      static const size_t MaxLength = NameSignature::MaxLength;
+
+      PruningBounds() : computed(false), threshold(0) {}
+
+      /**
+       * Compute the bounds for the similarity_metric and the
+       * similarity_threshold (again whenever either of them changes).
+       */
+      void compute();
+
+      /**
+       * \return whether names of these lengths (shorter <= longer) can be
+       * at least similarity_threshold similar, by Scorer::lengthBound().
+       */
+      bool lengthsMayMatch(size_t shorter, size_t longer) const
+        {
+          if (computed && shorter <= MaxLength)
+              return longer < lengthLimit[shorter];
+          return lengthBound(shorter, longer) >= similarity_threshold;
+        }
+
+      /**
+       * \return whether names of these lengths (shorter <= longer <=
+       * MaxLength) with common characters in common can be more than
+       * similarity_threshold similar, by Scorer::commonBound().
+       */
+      bool commonMayMatch(size_t common, size_t shorter, size_t longer) const
+        {
+          if (computed)
+              return common >= commonNeeded[shorter][longer];
+          return commonBound(common, shorter, longer) > similarity_threshold;
+        }
+
+      /**
+       * \return SimilarityKernel::minimumCommon(len1, threshold) if it was
+       * precomputed, or ~0u.
+       */
+      unsigned lcsNeeded(size_t len1, float threshold) const
+        {
+          if (computed && len1 <= MaxLength && threshold == this->threshold)
+              return lcsLengthNeeded[len1];
+          return ~0u;
+        }
+
+    private:
+      static float lengthBound(size_t shorter, size_t longer);
+      static float commonBound(size_t common, size_t shorter, size_t longer);
+
+      bool  computed;
+      float threshold;   ///< The similarity_threshold they were computed for
+
+      /// The partners of a name of length l are names shorter than lengthLimit[l].
+      uint32_t lengthLimit[MaxLength + 1];
+
+      /// The characters names of lengths shorter and longer need in common.
+      uint16_t commonNeeded[MaxLength + 1][MaxLength + 1];
+
+      /// The minimumCommon() of the LcsRatio of each length.
+      uint16_t lcsLengthNeeded[MaxLength + 1];
+  };
+
+const size_t PruningBounds::MaxLength;
+
+PruningBounds pruningBounds;
+
+/**
+ * Count steps of the bit-parallel LCS recurrence over text, unrolled at
+ * compile time (the halves recursively, so the depth stays logarithmic).
+ */
+template <size_t Count>
+struct BitParallelSteps
+  {
+    static inline uint64_t run(uint64_t row, const uint64_t* matchMask, const unsigned char* text)
+      {
+        row = BitParallelSteps<Count / 2>::run(row, matchMask, text);
+        return BitParallelSteps<Count - Count / 2>::run(row, matchMask, text + Count / 2);
+      }
+  };
+
+template <>
+struct BitParallelSteps<0>
+  {
+    static inline uint64_t run(uint64_t row, const uint64_t*, const unsigned char*)
+      {
+        return row;
+      }
+  };
+
+template <>
+struct BitParallelSteps<1>
+  {
+    static inline uint64_t run(uint64_t row, const uint64_t* matchMask, const unsigned char* text)
+      {
+        uint64_t matches = row & matchMask[*text];
+        return (row + matches) | (row - matches);
       }
+  };
+
+/**
+ * Scoring kernel behind similarityMetric().
+ *
+ * When the shorter string has at most WordLength characters (nearly all
+ * identifiers) the length of the longest common subsequence is computed
+ * bit-parallel, one machine word for the whole dynamic programming row.
+ * Longer strings use the row-by-row dynamic programming, whose two rows
+ * live on the stack for strings of up to SmallLength characters and
+ * otherwise in scratch rows owned by the kernel, which only ever grow.
+ * Either way a comparison does not allocate.  The pairs of strings of at
+ * most ShortLength characters, where identifier lengths cluster, are
+ * dispatched by the length of the longer one to a kernel specialized for
+ * that length, which runs the recurrence unrolled.  A kernel must not be shared
+ * between threads, use SimilarityKernel::threadLocal() to get the calling
+ * thread's instance.
+ *
+ * The batched comparisons score one query against a CandidateBlock, running
+ * the bit-parallel recurrence for Lanes candidates at once with AVX-512 or
+ * AVX2 when the compiler targets them (and a scalar loop otherwise).
+ */
+class SimilarityKernel
+  {
+    public:
+      static const size_t SmallLength = 64;
+      static const size_t WordLength  = 64;
+      static const size_t ShortLength = 32;
+
+      SimilarityKernel();
+
+      /**
+       * \return the length of the longest common subsequence of str1 and
+       * str2, where len1 >= len2 are their lengths.
+       */
+      unsigned lcsLength(const char* str1, size_t len1, const char* str2, size_t len2);
 
-    lenLCS = (float)previous[len1];
+      /**
+       * lcsLength() if it is at least needed, otherwise some length less
+       * than needed, stopping as soon as that is certain.
+       */
+      unsigned lcsLengthAtLeast(const char* str1, size_t len1, const char* str2, size_t len2, unsigned needed);
+
+      /**
+       * lcsLengthAtLeast() by dynamic programming, one row at a time.  Only
+       * the band of cells a common subsequence of needed characters can
+       * pass through is computed (all of them for needed = 0), and the rows
+       * stop once the rest of str2 cannot make up the difference.
+       */
+      unsigned lcsLengthByRows(const char* str1, size_t len1, const char* str2, size_t len2, unsigned needed = 0);
+
+      /**
+       * lcsLengthAtLeast() for a pattern of at most WordLength characters
+       * using the bit-vector algorithm of Allison and Dix (as formulated by
+       * Hyyro): bit k of the row is clear where the LCS length steps up at
+       * pattern[k].
+       */
+      unsigned lcsLengthBitParallel(const char* pattern, size_t patternLength, const char* text, size_t textLength,
+                                    unsigned needed = 0);
 
-    free(previous);
-    free(next);
+      /**
+       * lcsLengthBitParallel() for a text of exactly TextLength characters
+       * (at most ShortLength, and no shorter than the pattern).
+       */
+      template <size_t TextLength>
+      unsigned lcsLengthFixed(const char* pattern, size_t patternLength, const char* text);
+
+      /**
+       * \return similarityMetric(strX, strY), given the lengths of the strings
+       */
+      float similarity(const char* strX, size_t lenX, const char* strY, size_t lenY);
+
+      /**
+       * \return similarity() if it is more than threshold, otherwise some
+       * similarity of at most threshold
+       */
+      float similarityAbove(const char* strX, size_t lenX, const char* strY, size_t lenY, float threshold);
+
+      /**
+       * \return the least length of a common subsequence that makes two
+       * strings, the longer of length len1, more than threshold similar
+       * (len1 + 1 if none does)
+       */
+      static unsigned minimumCommon(size_t len1, float threshold);
+
+      /**
+       * Store similarity(query, candidate k) in scores[k - first] for each
+       * candidate k in [first, last) of block.
+       */
+      void similarityBatch(const char* query, size_t queryLength,
+                           const CandidateBlock& block, size_t first, size_t last,
+                           float* scores);
+
+      /**
+       * Set bit (k - first) of the bitmask matches for each candidate k in
+       * [first, last) of block that is more than threshold similar to query
+       * (and clear the others); matches holds (last - first + 63) / 64 words.
+       */
+      void matchBatch(const char* query, size_t queryLength,
+                      const CandidateBlock& block, size_t first, size_t last,
+                      float threshold, uint64_t* matches);
+
+      /**
+       * As matchBatch() for the candidates selected[0 .. count) of block (in
+       * increasing order), bit s of matches being that of selected[s]: only
+       * the lane groups of the selected candidates are computed.
+       */
+      void matchSelected(const char* query, size_t queryLength,
+                         const CandidateBlock& block, const size_t* selected, size_t count,
+                         float threshold, uint64_t* matches);
+
+      /**
+       * \return the lcsLength()s computed by the last matchBatch() (by k -
+       * first) or matchSelected() (by s), from which the similarity of the
+       * matches follows without computing them again.
+       */
+      const unsigned* batchLengths() const { return &batchScratch[0]; }
+
+      /**
+       * Store lcsLength() of query and candidate k in lcs[k - first] for
+       * each candidate k in [first, last) of block.
+       */
+      void lcsLengthBatch(const char* query, size_t queryLength,
+                          const CandidateBlock& block, size_t first, size_t last,
+                          unsigned* lcs);
+
+      /**
+       * Store lcsLength() of query and candidate selected[s] in lcs[s] for
+       * each of the count candidates selected (in increasing order).
+       */
+      void lcsLengthSelected(const char* query, size_t queryLength,
+                             const CandidateBlock& block, const size_t* selected, size_t count,
+                             unsigned* lcs);
+
+      /**
+       * \return the kernel owned by the calling thread
+       */
+      static SimilarityKernel& threadLocal();
+
+    private:
+      /**
+       * Run the bit-parallel recurrence for the query in matchMask over all
+       * the lanes of group g of block, leaving the final rows in rows.
+       */
+      void laneGroupRows(const CandidateBlock& block, size_t g, uint64_t* rows) const;
+
+      vector<unsigned> scratch;
+      vector<unsigned> batchScratch;
+
+      typedef unsigned (SimilarityKernel::*FixedKernel)(const char* pattern, size_t patternLength, const char* text);
+
+      template <size_t TextLength> friend struct FixedKernels;
+
+      /// lcsLengthFixed<TextLength>, by TextLength.
+      FixedKernel fixedKernels[ShortLength + 1];
+
+      /// Bit k of matchMask[c] is set when pattern[k] == c (zero between calls).
+      uint64_t matchMask[256];
+
+      static pthread_key_t  threadLocalKey;
+      static pthread_once_t threadLocalOnce;
+
+      static void createThreadLocalKey();
+      static void destroyThreadLocal(void* kernel);
+  };
+
+const size_t   SimilarityKernel::SmallLength;
+const size_t   SimilarityKernel::WordLength;
+const size_t   SimilarityKernel::ShortLength;
+
+/**
+ * Fill in SimilarityKernel::fixedKernels up to TextLength.
+ */
+template <size_t TextLength>
+struct FixedKernels
+  {
+    static void fill(SimilarityKernel::FixedKernel* kernels)
+      {
+        kernels[TextLength] = &SimilarityKernel::lcsLengthFixed<TextLength>;
+        FixedKernels<TextLength - 1>::fill(kernels);
+      }
+  };
+
+template <>
+struct FixedKernels<0>
+  {
+    static void fill(SimilarityKernel::FixedKernel* kernels)
+      {
+        kernels[0] = &SimilarityKernel::lcsLengthFixed<0>;
+      }
+  };
+pthread_key_t  SimilarityKernel::threadLocalKey;
+pthread_once_t SimilarityKernel::threadLocalOnce = PTHREAD_ONCE_INIT;
+
+void
+SimilarityKernel::createThreadLocalKey()
+  {
+    pthread_key_create(&threadLocalKey, destroyThreadLocal);
+  }
+
+void
+SimilarityKernel::destroyThreadLocal(void* kernel)
+  {
+    delete (SimilarityKernel*) kernel;
+  }
+
+SimilarityKernel&
+SimilarityKernel::threadLocal()
+  {
+    pthread_once(&threadLocalOnce, createThreadLocalKey);
+
+    SimilarityKernel* kernel = (SimilarityKernel*) pthread_getspecific(threadLocalKey);
+    if (kernel == NULL)
+      {
+        kernel = new SimilarityKernel();
+        pthread_setspecific(threadLocalKey, kernel);
+      }
+
+    return *kernel;
+  }
+
+SimilarityKernel::SimilarityKernel()
+  {
+    memset(matchMask, 0, sizeof(matchMask));
+    FixedKernels<ShortLength>::fill(fixedKernels);
+  }
+
+unsigned
+SimilarityKernel::lcsLength(const char* str1, size_t len1, const char* str2, size_t len2)
+  {
+    ROSE_ASSERT(len1 >= len2);
+
+    if (len1 <= ShortLength)
+        return (this->*fixedKernels[len1])(str2, len2, str1);
+
+    if (len2 <= WordLength)
+        return lcsLengthBitParallel(str2, len2, str1, len1);
+
+    return lcsLengthByRows(str1, len1, str2, len2);
+  }
+
+unsigned
+SimilarityKernel::lcsLengthAtLeast(const char* str1, size_t len1, const char* str2, size_t len2, unsigned needed)
+  {
+    ROSE_ASSERT(len1 >= len2);
+
+    if (needed > len2)
+        return 0;
+
+    // Too few steps in the short kernels for an early exit to pay.
+    if (len1 <= ShortLength)
+        return (this->*fixedKernels[len1])(str2, len2, str1);
+
+    if (len2 <= WordLength)
+        return lcsLengthBitParallel(str2, len2, str1, len1, needed);
+
+    return lcsLengthByRows(str1, len1, str2, len2, needed);
+  }
+
+unsigned
+SimilarityKernel::lcsLengthBitParallel(const char* pattern, size_t patternLength, const char* text, size_t textLength,
+                                       unsigned needed)
+  {
+    ROSE_ASSERT(patternLength <= WordLength);
+
+    const unsigned char* p = (const unsigned char*) pattern;
+    const unsigned char* t = (const unsigned char*) text;
+
+    for (size_t k = 0; k < patternLength; ++k)
+        matchMask[p[k]] |= (uint64_t) 1 << k;
+
+    uint64_t patternBits = (patternLength == WordLength)
+        ? ~(uint64_t) 0
+        : ((uint64_t) 1 << patternLength) - 1;
+
+    // Each character of the text adds at most one to the LCS, so the length
+    // so far is only worth checking once fewer than needed characters remain.
+    size_t unchecked = (textLength > needed) ? textLength - needed : 0;
+
+    uint64_t row = ~(uint64_t) 0;
+    size_t j = 0;
+    for (; j < unchecked; ++j)
+      {
+        uint64_t matches = row & matchMask[t[j]];
+        row = (row + matches) | (row - matches);
+      }
+
+    for (; j < textLength; ++j)
+      {
+        uint64_t matches = row & matchMask[t[j]];
+        row = (row + matches) | (row - matches);
+
+        if (__builtin_popcountll(~row & patternBits) + (textLength - j - 1) < needed)
+            break;
+      }
+
+    for (size_t k = 0; k < patternLength; ++k)
+        matchMask[p[k]] = 0;
+
+    return (unsigned) __builtin_popcountll(~row & patternBits);
+  }
+
+template <size_t TextLength>
+unsigned
+SimilarityKernel::lcsLengthFixed(const char* pattern, size_t patternLength, const char* text)
+  {
+    ROSE_ASSERT(patternLength <= TextLength && TextLength <= ShortLength);
+
+    const unsigned char* p = (const unsigned char*) pattern;
+
+    for (size_t k = 0; k < patternLength; ++k)
+        matchMask[p[k]] |= (uint64_t) 1 << k;
+
+    uint64_t row = BitParallelSteps<TextLength>::run(~(uint64_t) 0, matchMask, (const unsigned char*) text);
+
+    for (size_t k = 0; k < patternLength; ++k)
+        matchMask[p[k]] = 0;
+
+    return (unsigned) __builtin_popcountll(~row & (((uint64_t) 1 << patternLength) - 1));
+  }
+
+unsigned
+SimilarityKernel::lcsLengthByRows(const char* str1, size_t len1, const char* str2, size_t len2, unsigned needed)
+  {
+    ROSE_ASSERT(len1 >= len2);
+    ROSE_ASSERT(needed <= len2);
+
+    unsigned smallRows[2 * (SmallLength + 1)];
+    unsigned j, k, *previous, *next;
+
+    if (len1 <= SmallLength)
+      {
+        previous = smallRows;
+      }
+    else
+      {
+        if (scratch.size() < 2 * (len1 + 1))
+            scratch.resize(2 * (len1 + 1));
+        previous = &scratch[0];
+      }
+
+    next = previous + len1 + 1;
+    memset(previous, 0, 2 * (len1 + 1) * sizeof(unsigned));
+
+    // A common subsequence of needed characters leaves at most len1 - needed
+    // characters of str1 and len2 - needed of str2 unmatched, so its path
+    // through the table stays within that many cells of the diagonal.  The
+    // cells outside the band keep the values of earlier rows, which are no
+    // more than their own, so the band is still exact for such paths.
+    size_t above = len1 - needed,
+           below = len2 - needed;
+
+    for(j=0; j<len2; ++j)
+      {
+        size_t first = (j + 1 > below) ? j + 1 - below : 1,
+               last  = min(len1, j + 1 + above);
+
+        for(k=first; k<=last; ++k)
+             if( str1[k-1] == str2[j])
+                  next[k]=previous[k-1]+1;
+               else
+                  next[k] = previous[k] >= next[k-1] ? previous[k] : next[k-1];
+
+     // Note that this as a function might eliminate oportunities for optimization.
+        swap( &previous, &next);
+
+     // The rows of the band only increase to the right, and each remaining
+     // row of str2 adds at most one.
+        if (previous[last] + (len2 - j - 1) < needed)
+             return previous[last];
+      }
+
+    return previous[len1];
+  }
+
+float
+SimilarityKernel::similarity(const char* strX, size_t lenX, const char* strY, size_t lenY)
+  {
+    const char *str1 = (lenX > lenY) ? strX : strY,
+               *str2 = (lenX > lenY) ? strY : strX;
+
+    size_t len1 = (lenX > lenY) ? lenX : lenY,
+           len2 = (lenX > lenY) ? lenY : lenX;
+
+    if (len1 == 0 || len2 == 0)
+        return 0.0;
+
+    float lenLCS = (float) lcsLength(str1, len1, str2, len2);
+
+    return lenLCS /= len1;
+  }
+
+float
+SimilarityKernel::similarityAbove(const char* strX, size_t lenX, const char* strY, size_t lenY, float threshold)
+  {
+    const char *str1 = (lenX > lenY) ? strX : strY,
+               *str2 = (lenX > lenY) ? strY : strX;
+
+    size_t len1 = (lenX > lenY) ? lenX : lenY,
+           len2 = (lenX > lenY) ? lenY : lenX;
+
+    if (len1 == 0 || len2 == 0)
+        return 0.0;
+
+    float lenLCS = (float) lcsLengthAtLeast(str1, len1, str2, len2, minimumCommon(len1, threshold));
+
+    return lenLCS /= len1;
+  }
+
+unsigned
+SimilarityKernel::minimumCommon(size_t len1, float threshold)
+  {
+    if (threshold < 0)
+        return 0;
+
+    unsigned tabled = pruningBounds.lcsNeeded(len1, threshold);
+    if (tabled != ~0u)
+        return tabled;
+
+    // Start from the estimate and settle it by the same arithmetic as
+    // similarity(), so that exactly the same pairs pass.
+    unsigned needed = (unsigned) min((float) len1, threshold * len1);
+    while (needed > 0 && (float) (needed - 1) / len1 > threshold)
+        --needed;
+    while (needed <= len1 && !((float) needed / len1 > threshold))
+        ++needed;
+
+    return needed;
+  }
+
+void
+SimilarityKernel::laneGroupRows(const CandidateBlock& block, size_t g, uint64_t* rows) const
+  {
+    const size_t Lanes = CandidateBlock::Lanes;
+
+    const unsigned char* c = block.groupCharacters(g);
+    size_t length = block.groupLength(g);
+
+#if defined(__AVX512F__)
+    __m512i row = _mm512_set1_epi64(-1);
+    for (size_t t = 0; t < length; ++t, c += Lanes)
+      {
+        __m256i index   = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) c));
+        __m512i matches = _mm512_and_si512(row, _mm512_i32gather_epi64(index, (const void*) matchMask, 8));
+        row = _mm512_or_si512(_mm512_add_epi64(row, matches), _mm512_sub_epi64(row, matches));
+      }
+    _mm512_storeu_si512((void*) rows, row);
+#elif defined(__AVX2__)
+    __m256i low  = _mm256_set1_epi64x(-1);
+    __m256i high = _mm256_set1_epi64x(-1);
+    for (size_t t = 0; t < length; ++t, c += Lanes)
+      {
+        __m128i bytes = _mm_loadl_epi64((const __m128i*) c);
+        __m256i lowMatches  = _mm256_and_si256(low,
+            _mm256_i32gather_epi64((const long long*) matchMask, _mm_cvtepu8_epi32(bytes), 8));
+        __m256i highMatches = _mm256_and_si256(high,
+            _mm256_i32gather_epi64((const long long*) matchMask, _mm_cvtepu8_epi32(_mm_srli_si128(bytes, 4)), 8));
+        low  = _mm256_or_si256(_mm256_add_epi64(low, lowMatches), _mm256_sub_epi64(low, lowMatches));
+        high = _mm256_or_si256(_mm256_add_epi64(high, highMatches), _mm256_sub_epi64(high, highMatches));
+      }
+    _mm256_storeu_si256((__m256i*) rows, low);
+    _mm256_storeu_si256((__m256i*) (rows + 4), high);
+#else
+    for (size_t k = 0; k < Lanes; ++k)
+        rows[k] = ~(uint64_t) 0;
+
+    for (size_t t = 0; t < length; ++t, c += Lanes)
+      {
+        for (size_t k = 0; k < Lanes; ++k)
+          {
+            uint64_t matches = rows[k] & matchMask[c[k]];
+            rows[k] = (rows[k] + matches) | (rows[k] - matches);
+          }
+      }
+#endif
+  }
+
+void
+SimilarityKernel::lcsLengthBatch(const char* query, size_t queryLength,
+                                 const CandidateBlock& block, size_t first, size_t last,
+                                 unsigned* lcs)
+  {
+    const size_t Lanes = CandidateBlock::Lanes;
+
+    ROSE_ASSERT(first <= last && last <= block.size());
+
+    if (queryLength > WordLength)
+      {
+     // The query does not fit in a word, compare the candidates one by one.
+        for (size_t k = first; k < last; ++k)
+          {
+            const char* candidate = block.name(k);
+            size_t candidateLength = block.length(k);
+
+            lcs[k - first] = (queryLength >= candidateLength)
+                ? lcsLength(query, queryLength, candidate, candidateLength)
+                : lcsLength(candidate, candidateLength, query, queryLength);
+          }
+
+        return;
+      }
+
+    const unsigned char* p = (const unsigned char*) query;
+    for (size_t k = 0; k < queryLength; ++k)
+        matchMask[p[k]] |= (uint64_t) 1 << k;
+
+    uint64_t patternBits = (queryLength == WordLength)
+        ? ~(uint64_t) 0
+        : ((uint64_t) 1 << queryLength) - 1;
+
+    uint64_t rows[Lanes];
+    for (size_t g = first / Lanes; g * Lanes < last; ++g)
+      {
+        laneGroupRows(block, g, rows);
+
+        for (size_t k = max(first, g * Lanes); k < last && k < (g + 1) * Lanes; ++k)
+            lcs[k - first] = (unsigned) __builtin_popcountll(~rows[k % Lanes] & patternBits);
+      }
+
+    for (size_t k = 0; k < queryLength; ++k)
+        matchMask[p[k]] = 0;
+  }
+
+void
+SimilarityKernel::lcsLengthSelected(const char* query, size_t queryLength,
+                                    const CandidateBlock& block, const size_t* selected, size_t count,
+                                    unsigned* lcs)
+  {
+    const size_t Lanes = CandidateBlock::Lanes;
+
+    if (queryLength > WordLength)
+      {
+        for (size_t s = 0; s < count; ++s)
+          {
+            const char* candidate = block.name(selected[s]);
+            size_t candidateLength = block.length(selected[s]);
+
+            lcs[s] = (queryLength >= candidateLength)
+                ? lcsLength(query, queryLength, candidate, candidateLength)
+                : lcsLength(candidate, candidateLength, query, queryLength);
+          }
+
+        return;
+      }
+
+    const unsigned char* p = (const unsigned char*) query;
+    for (size_t k = 0; k < queryLength; ++k)
+        matchMask[p[k]] |= (uint64_t) 1 << k;
+
+    uint64_t patternBits = (queryLength == WordLength)
+        ? ~(uint64_t) 0
+        : ((uint64_t) 1 << queryLength) - 1;
+
+    // Each lane group is run once for all the selected candidates in it.
+    uint64_t rows[Lanes];
+    size_t   group = ~(size_t) 0;
+    for (size_t s = 0; s < count; ++s)
+      {
+        ROSE_ASSERT(selected[s] < block.size());
+
+        if (selected[s] / Lanes != group)
+          {
+            group = selected[s] / Lanes;
+            laneGroupRows(block, group, rows);
+          }
+
+        lcs[s] = (unsigned) __builtin_popcountll(~rows[selected[s] % Lanes] & patternBits);
+      }
+
+    for (size_t k = 0; k < queryLength; ++k)
+        matchMask[p[k]] = 0;
+  }
+
+void
+SimilarityKernel::similarityBatch(const char* query, size_t queryLength,
+                                  const CandidateBlock& block, size_t first, size_t last,
+                                  float* scores)
+  {
+    if (batchScratch.size() < last - first)
+        batchScratch.resize(last - first);
+
+    lcsLengthBatch(query, queryLength, block, first, last, &batchScratch[0]);
+
+    for (size_t k = first; k < last; ++k)
+      {
+        size_t len1 = max(queryLength, (size_t) block.length(k));
+        size_t len2 = min(queryLength, (size_t) block.length(k));
+
+        float lenLCS = (float) batchScratch[k - first];
+        scores[k - first] = (len2 == 0) ? 0.0 : lenLCS /= len1;
+      }
+  }
+
+void
+SimilarityKernel::matchBatch(const char* query, size_t queryLength,
+                             const CandidateBlock& block, size_t first, size_t last,
+                             float threshold, uint64_t* matches)
+  {
+    if (batchScratch.size() < last - first)
+        batchScratch.resize(last - first);
+
+    lcsLengthBatch(query, queryLength, block, first, last, &batchScratch[0]);
+
+    memset(matches, 0, (last - first + 63) / 64 * sizeof(uint64_t));
+
+    for (size_t k = first; k < last; ++k)
+      {
+        size_t len1 = max(queryLength, (size_t) block.length(k));
+        size_t len2 = min(queryLength, (size_t) block.length(k));
+
+        if (len2 != 0 && batchScratch[k - first] >= minimumCommon(len1, threshold))
+            matches[(k - first) / 64] |= (uint64_t) 1 << ((k - first) % 64);
+      }
+  }
+
+void
+SimilarityKernel::matchSelected(const char* query, size_t queryLength,
+                                const CandidateBlock& block, const size_t* selected, size_t count,
+                                float threshold, uint64_t* matches)
+  {
+    if (batchScratch.size() < count)
+        batchScratch.resize(count);
+
+    lcsLengthSelected(query, queryLength, block, selected, count, &batchScratch[0]);
+
+    memset(matches, 0, (count + 63) / 64 * sizeof(uint64_t));
+
+    for (size_t s = 0; s < count; ++s)
+      {
+        size_t len1 = max(queryLength, (size_t) block.length(selected[s]));
+        size_t len2 = min(queryLength, (size_t) block.length(selected[s]));
+
+        if (len2 != 0 && batchScratch[s] >= minimumCommon(len1, threshold))
+            matches[s / 64] |= (uint64_t) 1 << (s % 64);
+      }
+  }
+
+/**
+ * The similarity metrics (see --metric):
+ *
+ *   LcsRatio           the length of the longest common subsequence over
+ *                      the length of the longer string
+ *   RatcliffObershelp  twice the number of matching characters over the
+ *                      total length, the matching characters being the
+ *                      longest common substring plus, recursively, the
+ *                      matching characters on either side of it
+ *   Levenshtein        one minus the edit distance over the length of the
+ *                      longer string
+ */
+enum Metric { LcsRatio, RatcliffObershelp, Levenshtein, NumberOfMetrics };
+
+Metric similarity_metric = LcsRatio;
+
+/**
+ * A similarity metric, in [0, 1], with the bounds the scoring
+ * uses to skip the pairs that can't be similar enough.  Scorers keep
+ * scratch space and must not be shared between threads, use
+ * Scorer::threadLocal() to get the calling thread's instance of the
+ * similarity_metric.
+ */
+class Scorer
+  {
+    public:
+      virtual ~Scorer() {}
+
+      virtual float similarity(const char* strX, size_t lenX, const char* strY, size_t lenY) = 0;
+
+      /**
+       * \return similarity() if it is more than threshold, and otherwise
+       * anything up to threshold: the comparison stops as soon as the
+       * similarity can't exceed it.
+       */
+      virtual float similarityAbove(const char* strX, size_t lenX, const char* strY, size_t lenY,
+                                    float threshold) = 0;
+
+      /**
+       * \return an upper bound of the similarity of strings of these lengths
+       * (which are not both zero).
+       */
+      virtual float lengthBound(size_t shorter, size_t longer) const = 0;
+
+      /**
+       * \return an upper bound of the similarity of strings of these lengths
+       * having (at most) common characters in common.
+       */
+      virtual float commonBound(size_t common, size_t shorter, size_t longer) const = 0;
+
+      /**
+       * \return the calling thread's scorer for similarity_metric
+       */
+      static Scorer& threadLocal();
+
+    private:
+      static pthread_key_t  threadLocalKey;
+      static pthread_once_t threadLocalOnce;
+
+      static void createThreadLocalKey();
+      static void destroyThreadLocal(void* scorers);
+  };
+
+pthread_key_t  Scorer::threadLocalKey;
+pthread_once_t Scorer::threadLocalOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * LcsRatio is what SimilarityKernel computes.
+ */
+class LcsScorer : public Scorer
+  {
+    public:
+      LcsScorer() : kernel(SimilarityKernel::threadLocal()) {}
+
+      float similarity(const char* strX, size_t lenX, const char* strY, size_t lenY)
+        {
+          return kernel.similarity(strX, lenX, strY, lenY);
+        }
+
+      float similarityAbove(const char* strX, size_t lenX, const char* strY, size_t lenY,
+                            float threshold)
+        {
+          return kernel.similarityAbove(strX, lenX, strY, lenY, threshold);
+        }
+
+      float lengthBound(size_t shorter, size_t longer) const
+        {
+          return shorter / (float) longer;
+        }
+
+      float commonBound(size_t common, size_t /* shorter */, size_t longer) const
+        {
+          return common / (float) longer;
+        }
+
+    private:
+      SimilarityKernel& kernel;
+  };
+
+/**
+ * RatcliffObershelp, by longest common substrings of the unmatched parts.
+ */
+class RatcliffObershelpScorer : public Scorer
+  {
+    public:
+      float similarity(const char* strX, size_t lenX, const char* strY, size_t lenY)
+        {
+          return similarityAbove(strX, lenX, strY, lenY, -1);
+        }
+
+      float similarityAbove(const char* strX, size_t lenX, const char* strY, size_t lenY,
+                            float threshold);
+
+      float lengthBound(size_t shorter, size_t longer) const
+        {
+          return 2 * shorter / (float) (shorter + longer);
+        }
+
+      float commonBound(size_t common, size_t shorter, size_t longer) const
+        {
+          return 2 * common / (float) (shorter + longer);
+        }
+
+    private:
+      /**
+       * A pair of unmatched parts, [x, xEnd) of strX and [y, yEnd) of strY.
+       */
+      class Part
+        {
+          public:
+            size_t x, xEnd, y, yEnd;
+
+            Part(size_t x, size_t xEnd, size_t y, size_t yEnd)
+              : x(x), xEnd(xEnd), y(y), yEnd(yEnd)
+              {}
+
+            size_t bound() const { return min(xEnd - x, yEnd - y); }
+        };
+
+      vector<Part>     parts;
+      vector<unsigned> row;
+  };
+
+float
+RatcliffObershelpScorer::similarityAbove(const char* strX, size_t lenX, const char* strY, size_t lenY,
+                                         float threshold)
+  {
+    float total = (float) (lenX + lenY);
+    if (lenX == 0 || lenY == 0)
+        return lenX == lenY ? 1.0 : 0.0;
+
+    // The parts still to match can at best match completely.
+    size_t matched = 0;
+    size_t pending = min(lenX, lenY);
+
+    parts.clear();
+    parts.push_back(Part(0, lenX, 0, lenY));
+
+    while (parts.empty() == false)
+      {
+        if (2 * (matched + pending) / total <= threshold)
+            return 2 * (matched + pending) / total;
+
+        Part part = parts.back();
+        parts.pop_back();
+        pending -= part.bound();
+
+        // The (first) longest common substring of the two parts, by
+        // dynamic programming on the lengths of the common suffixes.
+        size_t width = part.yEnd - part.y;
+        row.assign(width + 1, 0);
+
+        size_t longest = 0, xLongest = 0, yLongest = 0;
+        for (size_t i = part.x; i < part.xEnd; ++i)
+          {
+            unsigned diagonal = 0;
+            for (size_t j = 1; j <= width; ++j)
+              {
+                unsigned above = row[j];
+                row[j] = strX[i] == strY[part.y + j - 1] ? diagonal + 1 : 0;
+                diagonal = above;
+
+                if (row[j] > longest)
+                  {
+                    longest  = row[j];
+                    xLongest = i + 1 - longest;
+                    yLongest = part.y + j - longest;
+                  }
+              }
+          }
+
+        if (longest == 0)
+            continue;
+
+        matched += longest;
+
+        Part left(part.x, xLongest, part.y, yLongest);
+        Part right(xLongest + longest, part.xEnd, yLongest + longest, part.yEnd);
+
+        if (left.bound() > 0)
+          {
+            parts.push_back(left);
+            pending += left.bound();
+          }
+
+        if (right.bound() > 0)
+          {
+            parts.push_back(right);
+            pending += right.bound();
+          }
+      }
+
+    return 2 * matched / total;
+  }
+
+/**
+ * Levenshtein, by dynamic programming restricted to the diagonal band
+ * within which the edit distance can stay low enough.
+ */
+class LevenshteinScorer : public Scorer
+  {
+    public:
+      float similarity(const char* strX, size_t lenX, const char* strY, size_t lenY)
+        {
+          return similarityAbove(strX, lenX, strY, lenY, -1);
+        }
+
+      float similarityAbove(const char* strX, size_t lenX, const char* strY, size_t lenY,
+                            float threshold);
+
+      float lengthBound(size_t shorter, size_t longer) const
+        {
+          return shorter / (float) longer;
+        }
+
+      float commonBound(size_t common, size_t /* shorter */, size_t longer) const
+        {
+          return common / (float) longer;
+        }
+
+    private:
+      vector<unsigned> previous;
+      vector<unsigned> row;
+  };
+
+float
+LevenshteinScorer::similarityAbove(const char* strX, size_t lenX, const char* strY, size_t lenY,
+                                   float threshold)
+  {
+    size_t longer = max(lenX, lenY);
+    if (longer == 0)
+        return 1.0;
+
+    // The largest distance that can still be a match: a distance of d
+    // leaves a similarity of 1 - d / longer.
+    // (leaving a character of slack for the rounding).
+    size_t band = longer;
+    if (threshold >= 0)
+        band = min(longer, (size_t) ((1 - threshold) * longer) + 1);
+
+    size_t difference = lenX > lenY ? lenX - lenY : lenY - lenX;
+    if (difference > band)
+        return 1 - difference / (float) longer;
+
+    // Row i holds the distances of the first i characters of strX to the
+    // prefixes of strY; the cells outside the band are more than band.
+    const unsigned outside = (unsigned) band + 1;
+
+    previous.assign(lenY + 1, outside);
+    row.assign(lenY + 1, outside);
+    for (size_t j = 0; j <= min(lenY, band); ++j)
+        previous[j] = (unsigned) j;
+
+    for (size_t i = 1; i <= lenX; ++i)
+      {
+        size_t jBegin = i > band ? i - band : 0;
+        size_t jEnd   = min(lenY, i + band);
+
+        if (jBegin > 0)
+            row[jBegin - 1] = outside;
+        row[jBegin] = jBegin == 0 ? (unsigned) i : outside;
+
+        unsigned smallest = row[jBegin];
+        for (size_t j = max(jBegin, (size_t) 1); j <= jEnd; ++j)
+          {
+            unsigned substitution = previous[j - 1] + (strX[i - 1] == strY[j - 1] ? 0 : 1);
+            unsigned deletion     = previous[j] + 1;
+            unsigned insertion    = row[j - 1] + 1;
+
+            unsigned distance = min(substitution, min(deletion, insertion));
+            row[j] = min(distance, outside);
+            smallest = min(smallest, row[j]);
+          }
+
+        if (jEnd < lenY)
+            row[jEnd + 1] = outside;
+
+        // Distances never decrease down a diagonal.
+        if (smallest > band)
+            return 1 - smallest / (float) longer;
+
+        previous.swap(row);
+      }
+
+    return 1 - previous[lenY] / (float) longer;
+  }
+
+void
+Scorer::createThreadLocalKey()
+  {
+    pthread_key_create(&threadLocalKey, destroyThreadLocal);
+  }
+
+void
+Scorer::destroyThreadLocal(void* scorers)
+  {
+    Scorer** scorer = (Scorer**) scorers;
+    for (int m = 0; m < NumberOfMetrics; ++m)
+        delete scorer[m];
+    delete [] scorer;
+  }
+
+Scorer&
+Scorer::threadLocal()
+  {
+    pthread_once(&threadLocalOnce, createThreadLocalKey);
+
+    Scorer** scorers = (Scorer**) pthread_getspecific(threadLocalKey);
+    if (scorers == NULL)
+      {
+        scorers = new Scorer*[NumberOfMetrics];
+        scorers[LcsRatio]          = new LcsScorer();
+        scorers[RatcliffObershelp] = new RatcliffObershelpScorer();
+        scorers[Levenshtein]       = new LevenshteinScorer();
+        pthread_setspecific(threadLocalKey, scorers);
+      }
+
+    return *scorers[similarity_metric];
+  }
+
+float
+PruningBounds::lengthBound(size_t shorter, size_t longer)
+  {
+    return Scorer::threadLocal().lengthBound(shorter, longer);
+  }
+
+float
+PruningBounds::commonBound(size_t common, size_t shorter, size_t longer)
+  {
+    return Scorer::threadLocal().commonBound(common, shorter, longer);
+  }
+
+void
+PruningBounds::compute()
+  {
+    computed = false;
+
+    // The bounds only drop with the longer length, and only rise with the
+    // characters in common: each limit is found by bisection.
+    for (size_t shorter = 0; shorter <= MaxLength; ++shorter)
+    {
+        uint64_t low = max(shorter, (size_t) 1), high = low;
+        while (high < ~(uint32_t) 0 && lengthBound(shorter, (size_t) high) >= similarity_threshold)
+        {
+            low  = high + 1;
+            high = min((uint64_t) ~(uint32_t) 0, 2 * high + 1);
+        }
+
+        // The limit is in [low, high]: the first length that fails.
+        while (low < high)
+        {
+            uint64_t middle = low + (high - low) / 2;
+            if (lengthBound(shorter, (size_t) middle) >= similarity_threshold)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+        lengthLimit[shorter] = (uint32_t) min(low, (uint64_t) ~(uint32_t) 0);
+
+        for (size_t longer = shorter; longer <= MaxLength; ++longer)
+        {
+            unsigned first = 0, last = MaxLength + 2;
+            while (first < last)
+            {
+                unsigned middle = (first + last) / 2;
+                if (commonBound(middle, shorter, longer) > similarity_threshold)
+                    last = middle;
+                else
+                    first = middle + 1;
+            }
+            commonNeeded[shorter][longer] = (uint16_t) first;
+        }
+
+        lcsLengthNeeded[shorter] = (uint16_t) SimilarityKernel::minimumCommon(shorter, similarity_threshold);
+    }
+
+    threshold = similarity_threshold;
+    computed  = true;
+  }
+
+/**
+ * \return the similarity of two strings (as a fraction), by the
+ * similarity_metric
+ *
+ * Assumes that both strings point to two valid, null-terminated
+ * char arrays.
+ *
+ * For example, by the LcsRatio ("fer" being the longest common
+ * subsequence, and either order giving the same),
+ *
+ *  ("buffer", "fer") = 0.5
+ *  ("fer", "buffer") = 0.5
+ */
+float
+similarityMetric(const char* strX, const char* strY)
+  {
+    return Scorer::threadLocal().similarity(strX, strlen(strX), strY, strlen(strY));
+  }
+
+/**
+ * \return whether similarityMetric(strX, strY) is more than threshold
+ *
+ * Assumes that both strings point to two valid, null-terminated
+ * char arrays.  Since most pairs of names are not similar, the
+ * comparison stops as soon as the similarity can't exceed threshold.
+ */
+bool
+similarityAtLeast(const char* strX, const char* strY, float threshold)
+  {
+    return Scorer::threadLocal().similarityAbove(strX, strlen(strX), strY, strlen(strY), threshold) > threshold;
+  }
+
+/**
+ * Tables of at most LcsCellBudget cells are used to reconstruct the longest
+ * common subsequences of longestCommonSubstring(), longer strings are split
+ * up (Hirschberg) so that it only needs linear space.
+ */
+const size_t LcsCellBudget = 1 << 20;
+
+/**
+ * Append to lcs the longest common subsequence of str1 and str2 that the
+ * backtracking of their whole table gives.
+ */
+void
+lcsByTable(const char* str1, size_t len1, const char* str2, size_t len2, string& lcs)
+  {
+    size_t width = len1 + 1;
+    vector<unsigned> align((len2 + 1) * width, 0);
+
+    for (size_t r = 1; r <= len2; ++r)
+      {
+        const unsigned* above = &align[(r - 1) * width];
+        unsigned*       row   = &align[r * width];
+
+        for (size_t c = 1; c <= len1; ++c)
+          {
+            if (str1[c - 1] == str2[r - 1])
+                row[c] = above[c - 1] + 1;
+              else
+                row[c] = above[c] >= row[c - 1] ? above[c] : row[c - 1];
+          }
+      }
+
+    size_t r = len2, c = len1;
+    unsigned i = align[r * width + c];
+
+    size_t start = lcs.size();
+    lcs.resize(start + i);
+
+    while (i > 0 && r > 0 && c > 0)
+      {
+        if (align[(r - 1) * width + c] == i)
+            --r;
+          else if (align[r * width + c - 1] == i)
+            --c;
+          else
+          {
+            lcs[start + i - 1] = str2[--r];
+            --c;
+          }
+
+        i = align[r * width + c];
+      }
+  }
+
+/**
+ * Compute into row[c] the length of the longest common subsequence of str2
+ * and the first c characters of str1 or, backward, of the reversed strings
+ * (i.e. of str2 and the last c characters of str1).
+ */
+void
+lcsLastRow(const char* str1, size_t len1, const char* str2, size_t len2, bool backward,
+           vector<unsigned>& row)
+  {
+    vector<unsigned> previous(len1 + 1, 0);
+    row.assign(len1 + 1, 0);
+
+    for (size_t r = 1; r <= len2; ++r)
+      {
+        char x = backward ? str2[len2 - r] : str2[r - 1];
+
+        for (size_t c = 1; c <= len1; ++c)
+          {
+            char y = backward ? str1[len1 - c] : str1[c - 1];
+            row[c] = x == y ? previous[c - 1] + 1 : max(previous[c], row[c - 1]);
+          }
+
+        previous.swap(row);
+      }
+
+    row.swap(previous);
+  }
+
+/**
+ * Append to lcs a longest common subsequence of str1 and str2, splitting
+ * str2 in halves (and str1 where a longest subsequence crosses over) for as
+ * long as their table would exceed the LcsCellBudget.
+ */
+void
+lcsByHalves(const char* str1, size_t len1, const char* str2, size_t len2, string& lcs)
+  {
+    if (len1 == 0 || len2 == 0)
+        return;
+
+    if ((len1 + 1) * (len2 + 1) <= LcsCellBudget)
+      {
+        lcsByTable(str1, len1, str2, len2, lcs);
+        return;
+      }
+
+    if (len2 == 1)
+      {
+        if (memchr(str1, str2[0], len1) != NULL)
+            lcs += str2[0];
+        return;
+      }
+
+    size_t middle = len2 / 2;
+
+    vector<unsigned> forward, backward;
+    lcsLastRow(str1, len1, str2, middle, false, forward);
+    lcsLastRow(str1, len1, str2 + middle, len2 - middle, true, backward);
+
+    size_t split = 0;
+    unsigned best = 0;
+    for (size_t c = 0; c <= len1; ++c)
+      {
+        if (forward[c] + backward[len1 - c] > best)
+          {
+            best  = forward[c] + backward[len1 - c];
+            split = c;
+          }
+      }
+
+    lcsByHalves(str1, split, str2, middle, lcs);
+    lcsByHalves(str1 + split, len1 - split, str2 + middle, len2 - middle, lcs);
+  }
+
+/**
+ * Compute into lcs one of the Longest Common Sequences of str1 and str2
+ * (of len1 and len2 characters).
+ *
+ * This is reentrant, so it may run on the threads of the scoring.
+ */
+void
+longestCommonSubstring(const char* str1, size_t len1, const char* str2, size_t len2, string& lcs)
+  {
+    lcs.clear();
+    lcsByHalves(str1, len1, str2, len2, lcs);
+  }
+
+void
+longestCommonSubstring(const char* str1, const char* str2, string& lcs)
+  {
+    longestCommonSubstring(str1, strlen(str1), str2, strlen(str2), lcs);
+  }
+
+/**
+ * A unit of work for the WorkStealingPool.
+ */
+class PoolTask
+  {
+    public:
+      virtual ~PoolTask() {}
+      virtual void run() = 0;
+  };
+
+/**
+ * A fixed set of threads executing batches of PoolTasks.
+ *
+ * Every worker has its own deque of tasks: it takes work from the back of
+ * its own deque and, once that is empty, steals from the front of the
+ * others'.  The thread calling run() takes part as worker 0, so a pool of
+ * N threads starts N-1 new ones.
+ */
+class WorkStealingPool
+  {
+    public:
+      WorkStealingPool(unsigned numberOfThreads);
+      ~WorkStealingPool();
+
+      /**
+       * Execute all the tasks, returning once every one of them has completed.
+       */
+      void run(const vector<PoolTask*>& tasks);
+
+      unsigned size() const { return (unsigned) workers.size(); }
+
+    private:
+      struct Worker
+        {
+          WorkStealingPool* pool;
+          unsigned          index;
+          pthread_t         thread;
+          pthread_mutex_t   lock;
+          deque<PoolTask*>  tasks;
+        };
+
+      static void* threadMain(void* worker);
+
+      PoolTask* take(unsigned index);
+      void work(unsigned index);
+
+      vector<Worker*> workers;
+
+      pthread_mutex_t lock;
+      pthread_cond_t  wakeUp;
+      pthread_cond_t  finished;
+      unsigned long   generation;
+      size_t          remaining;
+      bool            shuttingDown;
+  };
+
+WorkStealingPool::WorkStealingPool(unsigned numberOfThreads)
+  : generation(0),
+    remaining(0),
+    shuttingDown(false)
+  {
+    ROSE_ASSERT(numberOfThreads >= 1);
+
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&wakeUp, NULL);
+    pthread_cond_init(&finished, NULL);
+
+    for (unsigned i = 0; i < numberOfThreads; ++i)
+      {
+        Worker* worker = new Worker();
+        worker->pool  = this;
+        worker->index = i;
+        pthread_mutex_init(&worker->lock, NULL);
+        workers.push_back(worker);
+      }
+
+    for (unsigned i = 1; i < numberOfThreads; ++i)
+      {
+        int status = pthread_create(&workers[i]->thread, NULL, threadMain, workers[i]);
+        ROSE_ASSERT(status == 0);
+      }
+  }
+
+WorkStealingPool::~WorkStealingPool()
+  {
+    pthread_mutex_lock(&lock);
+    shuttingDown = true;
+    pthread_cond_broadcast(&wakeUp);
+    pthread_mutex_unlock(&lock);
+
+    for (unsigned i = 0; i < workers.size(); ++i)
+      {
+        if (i > 0)
+            pthread_join(workers[i]->thread, NULL);
+        pthread_mutex_destroy(&workers[i]->lock);
+        delete workers[i];
+      }
+
+    pthread_cond_destroy(&finished);
+    pthread_cond_destroy(&wakeUp);
+    pthread_mutex_destroy(&lock);
+  }
+
+void*
+WorkStealingPool::threadMain(void* argument)
+  {
+    Worker* worker = (Worker*) argument;
+    WorkStealingPool* pool = worker->pool;
+
+    pthread_mutex_lock(&pool->lock);
+    unsigned long seen = pool->generation;
+    while (true)
+      {
+        while (pool->generation == seen && pool->shuttingDown == false)
+            pthread_cond_wait(&pool->wakeUp, &pool->lock);
+
+        if (pool->shuttingDown)
+            break;
+
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        pool->work(worker->index);
+
+        pthread_mutex_lock(&pool->lock);
+      }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+  }
+
+PoolTask*
+WorkStealingPool::take(unsigned index)
+  {
+    PoolTask* task = NULL;
+
+    Worker* own = workers[index];
+    pthread_mutex_lock(&own->lock);
+    if (own->tasks.empty() == false)
+      {
+        task = own->tasks.back();
+        own->tasks.pop_back();
+      }
+    pthread_mutex_unlock(&own->lock);
+
+    for (unsigned k = 1; task == NULL && k < workers.size(); ++k)
+      {
+        Worker* victim = workers[(index + k) % workers.size()];
+        pthread_mutex_lock(&victim->lock);
+        if (victim->tasks.empty() == false)
+          {
+            task = victim->tasks.front();
+            victim->tasks.pop_front();
+          }
+        pthread_mutex_unlock(&victim->lock);
+      }
+
+    return task;
+  }
+
+void
+WorkStealingPool::work(unsigned index)
+  {
+    PoolTask* task;
+    while ((task = take(index)) != NULL)
+      {
+        task->run();
+
+        pthread_mutex_lock(&lock);
+        if (--remaining == 0)
+            pthread_cond_signal(&finished);
+        pthread_mutex_unlock(&lock);
+      }
+  }
+
+void
+WorkStealingPool::run(const vector<PoolTask*>& tasks)
+  {
+    if (tasks.empty())
+        return;
+
+    // The tasks are counted before any of them can be taken: a worker
+    // still looking for the tasks of the previous run may take one as soon
+    // as it is dealt out.
+    pthread_mutex_lock(&lock);
+    remaining = tasks.size();
+    pthread_mutex_unlock(&lock);
+
+    // Deal the tasks out round robin, contiguous tasks going to different
+    // workers (neighbouring tiles tend to cost about the same).
+    for (size_t t = 0; t < tasks.size(); ++t)
+      {
+        Worker* worker = workers[t % workers.size()];
+        pthread_mutex_lock(&worker->lock);
+        worker->tasks.push_back(tasks[t]);
+        pthread_mutex_unlock(&worker->lock);
+      }
+
+    pthread_mutex_lock(&lock);
+    ++generation;
+    pthread_cond_broadcast(&wakeUp);
+    pthread_mutex_unlock(&lock);
+
+    work(0);
+
+    pthread_mutex_lock(&lock);
+    while (remaining > 0)
+        pthread_cond_wait(&finished, &lock);
+    pthread_mutex_unlock(&lock);
+  }
+
+/**
+ * A first in, first out queue of at most capacity items, between threads:
+ * push() waits while the queue is full, pop() while it is empty.
+ */
+template <class Item>
+class BoundedQueue
+  {
+    public:
+      BoundedQueue(size_t capacity);
+      ~BoundedQueue();
+
+      void push(const Item& item);
+
+      /**
+       *  \return false once the queue is closed and empty.
+       */
+      bool pop(Item& item);
+
+      /**
+       *  No more items will be pushed.
+       */
+      void close();
+
+    private:
+      BoundedQueue(const BoundedQueue &);             // not copyable
+      BoundedQueue & operator=(const BoundedQueue &);
+
+      deque<Item>     items;
+      size_t          capacity;
+      bool            closed;
+      pthread_mutex_t lock;
+      pthread_cond_t  notEmpty;
+      pthread_cond_t  notFull;
+  };
+
+template <class Item>
+BoundedQueue<Item>::BoundedQueue(size_t capacity)
+  : capacity(capacity),
+    closed(false)
+  {
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&notEmpty, NULL);
+    pthread_cond_init(&notFull, NULL);
+  }
+
+template <class Item>
+BoundedQueue<Item>::~BoundedQueue()
+  {
+    pthread_cond_destroy(&notFull);
+    pthread_cond_destroy(&notEmpty);
+    pthread_mutex_destroy(&lock);
+  }
+
+template <class Item>
+void
+BoundedQueue<Item>::push(const Item& item)
+  {
+    pthread_mutex_lock(&lock);
+    while (items.size() >= capacity)
+        pthread_cond_wait(&notFull, &lock);
+    items.push_back(item);
+    pthread_cond_signal(&notEmpty);
+    pthread_mutex_unlock(&lock);
+  }
+
+template <class Item>
+bool
+BoundedQueue<Item>::pop(Item& item)
+  {
+    pthread_mutex_lock(&lock);
+    while (items.empty() && closed == false)
+        pthread_cond_wait(&notEmpty, &lock);
+
+    bool popped = items.empty() == false;
+    if (popped)
+      {
+        item = items.front();
+        items.pop_front();
+        pthread_cond_signal(&notFull);
+      }
+    pthread_mutex_unlock(&lock);
+    return popped;
+  }
+
+template <class Item>
+void
+BoundedQueue<Item>::close()
+  {
+    pthread_mutex_lock(&lock);
+    closed = true;
+    pthread_cond_broadcast(&notEmpty);
+    pthread_mutex_unlock(&lock);
+  }
+
+typedef uint32_t NameId; ///< Index of a name in the NameTable
+
+/**
+ * What a declared name is, for the ComparisonRules: a function, a parameter
+ * of a function definition or of a declaration without one (a prototype),
+ * a variable of a function (or block), of the global scope or a namespace,
+ * or of a class, or a namespace.
+ */
+enum NameKind { FunctionName, ParameterName, PrototypeParameterName, LocalName, GlobalName,
+                MemberName, NamespaceName, NumberOfNameKinds };
+
+/**
+ * The kinds of scope whose names are compared (see ComparisonRules::scopeKind()).
+ */
+enum ScopeKind { GlobalScope, NamespaceScope, ClassScope, FunctionScope, BlockScope,
+                 NumberOfScopeKinds };
+
+/**
+ * Which kinds of names are compared with which, and in which kinds of scope
+ * (see --compare): by default, everything with everything everywhere.
+ *
+ * A rule "KINDS[:KINDS][@SCOPES]" compares the names of the first kinds
+ * with those of the second (or with each other), in the scopes of the
+ * given kinds (or all of them); the kinds are lists separated by commas,
+ * "all" being every kind.  The names of the kinds no rule compares are
+ * not even collected.
+ */
+class ComparisonRules
+  {
+    public:
+      ComparisonRules() : restricted(false) { clear(~(uint32_t) 0); }
+
+      /**
+       *  Add the rule (the first one replacing the default).
+       *  \return false if it is not valid.
+       */
+      bool add(const string& rule);
+
+      /**
+       *  \return false if every pair of names is compared everywhere.
+       */
+      bool active() const { return restricted; }
+
+      /**
+       *  \return false if no rule compares the names of this kind.
+       */
+      bool collects(NameKind kind) const { return collected & (1u << kind); }
+
+      /**
+       *  \return the masks of the kinds (1 << NameKind) each kind of name is
+       *  compared with in the scopes of this kind.
+       */
+      const uint32_t* partners(ScopeKind scope) const { return matrix[scope]; }
+
+      /**
+       *  \return true if the scopes of this kind compare every pair of names
+       *  of these kinds (a mask) that any kind of scope compares, so that
+       *  the enclosing scopes need not compare them again (see
+       *  incremental_mode).
+       */
+      bool complete(ScopeKind scope, uint32_t kinds) const;
+
+      /**
+       *  \return hash combined with the rules.
+       */
+      uint64_t hash(uint64_t hash) const;
+
+      /**
+       *  \return the kind of scope of this class name (anything that is not
+       *  a global, namespace, class or function scope is a block).
+       */
+      static ScopeKind scopeKind(const char* className);
+
+      static const char* nameKinds[NumberOfNameKinds];
+      static const char* scopeKinds[NumberOfScopeKinds];
+
+    private:
+      void clear(uint32_t mask);
+
+      /**
+       *  \return false unless list is made of the names (or "all").
+       */
+      static bool parseList(const string& list, const char* const* names, size_t count,
+                            uint32_t& mask);
+
+      bool     restricted;
+      uint32_t collected;
+      uint32_t matrix[NumberOfScopeKinds][NumberOfNameKinds];
+  };
+
+const char* ComparisonRules::nameKinds[NumberOfNameKinds] =
+  { "function", "parameter", "prototype-parameter", "local", "global", "member", "namespace" };
+
+const char* ComparisonRules::scopeKinds[NumberOfScopeKinds] =
+  { "global", "namespace", "class", "function", "block" };
+
+ComparisonRules comparisonRules;
+
+void
+ComparisonRules::clear(uint32_t mask)
+  {
+    collected = mask;
+    for (int scope = 0; scope < NumberOfScopeKinds; ++scope)
+        for (int kind = 0; kind < NumberOfNameKinds; ++kind)
+            matrix[scope][kind] = mask;
+  }
+
+bool
+ComparisonRules::parseList(const string& list, const char* const* names, size_t count, uint32_t& mask)
+  {
+    mask = 0;
+
+    size_t begin = 0;
+    while (begin <= list.size())
+      {
+        size_t end = list.find(',', begin);
+        if (end == string::npos)
+            end = list.size();
+
+        string name = list.substr(begin, end - begin);
+        size_t k = 0;
+        while (k < count && name != names[k])
+            ++k;
+
+        if (name == "all")
+            mask |= (1u << count) - 1;
+        else if (k < count)
+            mask |= 1u << k;
+        else
+            return false;
+
+        begin = end + 1;
+      }
+
+    return true;
+  }
+
+bool
+ComparisonRules::add(const string& rule)
+  {
+    size_t at = rule.find('@');
+    string names = rule.substr(0, at);
+    string scopes = (at != string::npos) ? rule.substr(at + 1) : string("all");
+
+    size_t colon = names.find(':');
+    string first  = names.substr(0, colon);
+    string second = (colon != string::npos) ? names.substr(colon + 1) : first;
+
+    uint32_t firstKinds, secondKinds, scopeMask;
+    if (parseList(first, nameKinds, NumberOfNameKinds, firstKinds) == false ||
+        parseList(second, nameKinds, NumberOfNameKinds, secondKinds) == false ||
+        parseList(scopes, scopeKinds, NumberOfScopeKinds, scopeMask) == false)
+        return false;
+
+    if (restricted == false)
+      {
+        clear(0);
+        restricted = true;
+      }
+
+    // The rules are symmetric: a pair may be given either way round.
+    collected |= firstKinds | secondKinds;
+    for (int scope = 0; scope < NumberOfScopeKinds; ++scope)
+      {
+        if ((scopeMask & (1u << scope)) == 0)
+            continue;
+
+        for (int kind = 0; kind < NumberOfNameKinds; ++kind)
+          {
+            if (firstKinds & (1u << kind))
+                matrix[scope][kind] |= secondKinds;
+            if (secondKinds & (1u << kind))
+                matrix[scope][kind] |= firstKinds;
+          }
+      }
+
+    return true;
+  }
+
+bool
+ComparisonRules::complete(ScopeKind scope, uint32_t kinds) const
+  {
+    for (int other = 0; other < NumberOfScopeKinds; ++other)
+        for (int kind = 0; kind < NumberOfNameKinds; ++kind)
+            if ((kinds & (1u << kind)) && (matrix[other][kind] & kinds & ~matrix[scope][kind]) != 0)
+                return false;
+
+    return true;
+  }
+
+uint64_t
+ComparisonRules::hash(uint64_t hash) const
+  {
+    hash = hashBytes(&restricted, sizeof(restricted), hash);
+    return hashBytes(matrix, sizeof(matrix), hash);
+  }
+
+ScopeKind
+ComparisonRules::scopeKind(const char* className)
+  {
+    // The template versions of the definitions are kinds of them too.
+    if (strcmp(className, "SgGlobal") == 0)
+        return GlobalScope;
+    if (strstr(className, "NamespaceDefinition") != NULL)
+        return NamespaceScope;
+    if (strstr(className, "ClassDefinition") != NULL)
+        return ClassScope;
+    if (strstr(className, "FunctionDefinition") != NULL)
+        return FunctionScope;
+
+    return BlockScope;
+  }
+
+/**
+ * \return the kind of the name declared at n (a function, namespace or
+ * initialized name).
+ */
+NameKind
+nameKindOf(SgNode* n)
+  {
+    if (isSgFunctionDeclaration(n) != NULL)
+        return FunctionName;
+    if (isSgNamespaceDeclarationStatement(n) != NULL)
+        return NamespaceName;
+
+    SgNode* parent = n->get_parent();
+    if (isSgFunctionParameterList(parent) != NULL)
+      {
+        SgFunctionDeclaration* function = isSgFunctionDeclaration(parent->get_parent());
+        return (function != NULL && function->get_definition() == NULL) ? PrototypeParameterName : ParameterName;
+      }
+
+    // Variables are named after the scope declaring them.
+    while (parent != NULL && isSgScopeStatement(parent) == NULL)
+        parent = parent->get_parent();
+
+    if (isSgGlobal(parent) != NULL || isSgNamespaceDefinitionStatement(parent) != NULL)
+        return GlobalName;
+    if (isSgClassDefinition(parent) != NULL)
+        return MemberName;
+
+    return LocalName;
+  }
+
+/**
+ * What the reports say about the declaration of a name, or of a scope:
+ * recorded at extraction, so that scoring and reporting need no AST (see
+ * NameStream).  The strings are owned by the NameTable.
+ */
+class Declaration
+  {
+    public:
+      const void* node;   ///< Where the declaration was in the AST (only printed)
+      const char* kind;   ///< Its class name
+      const char* name;   ///< What SageInterface::get_name() gives for it
+      const char* file;
+      uint32_t    line;
+
+      Declaration()
+        : node(NULL),
+          kind(""),
+          name(""),
+          file(""),
+          line(0)
+        {}
+  };
+
+/**
+ * This structure is used to hold names and their links to the AST.
+ * When matches are found this allows for more information to be 
+ * output about where the names came from.  Identical names may
+ * match and in this case the information as to how they are used
+ * and what nested scope they came from, etc.
+ *
+ * The characters are owned by the NameTable (identical strings are
+ * stored once and share a stringId), so this is cheap to pass around.
+ */
+class NameStructure
+  {
+    public:
+      const char* name;
+      uint32_t    length;
+      NameId      stringId;
+      NameId      group;          ///< See incremental_mode
+      uint8_t     kind;           ///< Its NameKind
+      Declaration declaration;
+
+      NameStructure(const char* name, uint32_t length, NameId stringId, NameId group,
+                    NameKind kind, const Declaration& declaration)
+        : name(name),
+          length(length),
+          stringId(stringId),
+          group(group),
+          kind((uint8_t) kind),
+          declaration(declaration)
+        {}
+
+      size_t size() const { return length; }
+      const char* c_str() const { return name; }
+  };
+typedef NameStructure NameStructureType;
+
+/**
+ * Project-wide table of all the names collected by the traversal.
+ *
+ * Each distinct string is interned once into an arena of large chunks
+ * (so the character pointers stay valid as the table grows) and each
+ * occurrence of a name is a NameStructure addressed by a 32-bit NameId.
+ * Names are appended in the order the traversal synthesizes them, so
+ * the names found in any subtree occupy a contiguous range of ids.
+ */
+class NameTable
+  {
+    public:
+      NameTable();
+      ~NameTable();
+
+      /**
+       * Record an occurrence of name, interning the string if it is new.
+       * The declaration's name may be NULL if it is the name itself.
+       * \return the id of the new occurrence
+       */
+      NameId add(const string& name, const Declaration& declaration, NameKind kind = LocalName);
+
+      /**
+       * Intern name without recording an occurrence of it.
+       * \return its stringId
+       */
+      NameId addString(const string& name)
+        {
+          NameId stringId;
+          intern(name, stringId);
+          return stringId;
+        }
+
+      /**
+       * \return a copy of text owned by the table (the same for equal texts),
+       * for the strings of Declarations.
+       */
+      const char* label(const string& text);
+
+      /**
+       * \return the stringId of name, or NoString if it was never added.
+       */
+      NameId lookup(const string& name) const;
+
+      static const NameId NoString = ~(NameId) 0;
+
+      NameStructureType& operator[](NameId id) { return names[id]; }
+      const NameStructureType& operator[](NameId id) const { return names[id]; }
+
+      NameId size() const { return (NameId) names.size(); }
+      NameId numberOfStrings() const { return (NameId) strings.size(); }
+
+      const NameSignature& signature(NameId stringId) const { return signatures[stringId]; }
+
+      const char* stringOf(NameId stringId) const { return strings[stringId]; }
+      uint32_t stringLength(NameId stringId) const { return stringLengths[stringId]; }
+
+    private:
+      NameTable(const NameTable &);             // not copyable
+      NameTable & operator=(const NameTable &);
+
+      static const size_t ChunkSize = 64 * 1024;
+      static const NameId EmptyBucket = ~(NameId) 0;
+
+      static uint32_t hash(const string& name);
+      const char* intern(const string& name, NameId& stringId);
+      char* allocate(size_t bytes);
+      void rehash();
+
+      vector<char*> chunks;
+      size_t        chunkUsed;
+
+      /// Interned strings (indexed by stringId) and their hash values.
+      vector<const char*> strings;
+      vector<uint32_t>    stringLengths;
+      vector<uint32_t>    stringHashes;
+      vector<NameSignature> signatures;
+
+      /// Open addressing hash table of stringIds (size is a power of two).
+      vector<NameId>      buckets;
+
+      vector<NameStructureType> names;
+
+      /// The texts of label(), which are few but often repeated.
+      map<string, const char*> labels;
+  };
+
+const size_t NameTable::ChunkSize;
+const NameId NameTable::EmptyBucket;
+const NameId NameTable::NoString;
+
+NameTable::NameTable()
+  : chunkUsed(ChunkSize),
+    buckets(1024, EmptyBucket)
+  {
+  }
+
+NameTable::~NameTable()
+  {
+    for (size_t i = 0; i < chunks.size(); ++i)
+        free(chunks[i]);
+  }
+
+char*
+NameTable::allocate(size_t bytes)
+  {
+    if (bytes > ChunkSize)
+      {
+     // Oversized names get a chunk of their own (keeping the current one).
+        char* block = (char*) malloc(bytes);
+        chunks.insert(chunks.end() - (chunks.empty() ? 0 : 1), block);
+        return block;
+      }
+
+    if (chunkUsed + bytes > ChunkSize)
+      {
+        chunks.push_back((char*) malloc(ChunkSize));
+        chunkUsed = 0;
+      }
+
+    char* result = chunks.back() + chunkUsed;
+    chunkUsed += bytes;
+    return result;
+  }
+
+void
+NameTable::rehash()
+  {
+    buckets.assign(buckets.size() * 2, EmptyBucket);
+
+    size_t mask = buckets.size() - 1;
+    for (NameId s = 0; s < strings.size(); ++s)
+      {
+        size_t slot = stringHashes[s] & mask;
+        while (buckets[slot] != EmptyBucket)
+            slot = (slot + 1) & mask;
+        buckets[slot] = s;
+      }
+  }
+
+uint32_t
+NameTable::hash(const string& name)
+  {
+ // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < name.size(); ++i)
+        hash = (hash ^ (unsigned char) name[i]) * 16777619u;
+    return hash;
+  }
+
+NameId
+NameTable::lookup(const string& name) const
+  {
+    uint32_t hash = NameTable::hash(name);
+
+    size_t mask = buckets.size() - 1;
+    for (size_t slot = hash & mask; buckets[slot] != EmptyBucket; slot = (slot + 1) & mask)
+      {
+        NameId s = buckets[slot];
+        if (stringHashes[s] == hash && stringLengths[s] == name.size() &&
+            memcmp(strings[s], name.data(), name.size()) == 0)
+            return s;
+      }
+
+    return NoString;
+  }
+
+const char*
+NameTable::intern(const string& name, NameId& stringId)
+  {
+    uint32_t hash = NameTable::hash(name);
+
+    size_t mask = buckets.size() - 1;
+    size_t slot = hash & mask;
+    while (buckets[slot] != EmptyBucket)
+      {
+        NameId s = buckets[slot];
+        if (stringHashes[s] == hash && stringLengths[s] == name.size() &&
+            memcmp(strings[s], name.data(), name.size()) == 0)
+          {
+            stringId = s;
+            return strings[s];
+          }
+        slot = (slot + 1) & mask;
+      }
+
+    char* text = allocate(name.size() + 1);
+    memcpy(text, name.c_str(), name.size() + 1);
+
+    stringId = (NameId) strings.size();
+    strings.push_back(text);
+    stringLengths.push_back((uint32_t) name.size());
+    stringHashes.push_back(hash);
+    signatures.push_back(NameSignature());
+    signatures.back().assign(text, name.size());
+    buckets[slot] = stringId;
+
+ // Keep the load factor below one half.
+    if (2 * strings.size() > buckets.size())
+        rehash();
+
+    return text;
+  }
+
+NameId
+NameTable::add(const string& name, const Declaration& declaration, NameKind kind)
+  {
+    NameId stringId;
+    const char* text = intern(name, stringId);
+
+    NameId id = (NameId) names.size();
+    names.push_back(NameStructureType(text, (uint32_t) name.size(), stringId, id, kind, declaration));
+
+    if (declaration.name == NULL)
+        names.back().declaration.name = text;
+
+    return id;
+  }
+
+const char*
+NameTable::label(const string& text)
+  {
+    map<string, const char*>::iterator i = labels.find(text);
+    if (i == labels.end())
+      {
+        char* copy = allocate(text.size() + 1);
+        memcpy(copy, text.c_str(), text.size() + 1);
+        i = labels.insert(make_pair(text, (const char*) copy)).first;
+      }
+
+    return i->second;
+  }
+
+/**
+ * Project-wide memo of the similarity of pairs of interned strings (keyed
+ * on their two stringIds), so that a pair recurring in many scopes is
+ * scored once.  Lookups may run concurrently but insertions may not: tiles
+ * collect the scores they compute and these are inserted once the tiles
+ * of a scope have completed.
+ */
+class ScoreMemo
+  {
+    public:
+      /// Pairs of names shorter than this are cheaper to rescore than to look
+      /// up: a lookup in a memo of 1M scores takes about 14 ns, as long as
+      /// scoring two names of 5 characters, against 21 ns for 8 characters
+      /// and 35 ns for 16 (which only 3% of typical identifiers reach).
+      static const size_t MinLength = 8;
+
+      /// The memo stops growing once it holds this many scores.
+      static const size_t MaxEntries = 1 << 24;
+
+      /// The most memory a score takes: as it rehashes, the table being
+      /// replaced is half full and the new one a quarter full.
+      static const size_t EntryBytes = 6 * (sizeof(uint64_t) + sizeof(float));
+
+      ScoreMemo();
+
+      static uint64_t key(NameId stringA, NameId stringB);
+
+      bool lookup(uint64_t key, float& similarity) const;
+      void insert(uint64_t key, float similarity);
+
+      size_t size() const { return entries; }
+
+      /// The memo stops growing at MaxEntries, or in fewer bytes than these (if not 0).
+      void limit(size_t bytes) { capacity = bytes > 0 ? min(MaxEntries, bytes / EntryBytes) : MaxEntries; }
+      bool full(size_t pending = 0) const { return entries + pending >= capacity; }
+
+    private:
+      static const uint64_t EmptyKey = ~(uint64_t) 0;
+
+      size_t slot(uint64_t key) const;
+      void rehash();
+
+      vector<uint64_t> keys;   ///< Open addressing, size is a power of two
+      vector<float>    values;
+      size_t           entries;
+      size_t           capacity;
+  };
+
+const size_t   ScoreMemo::MinLength;
+const size_t   ScoreMemo::MaxEntries;
+const size_t   ScoreMemo::EntryBytes;
+const uint64_t ScoreMemo::EmptyKey;
+
+ScoreMemo::ScoreMemo()
+  : keys(1024, EmptyKey),
+    values(1024),
+    entries(0),
+    capacity(MaxEntries)
+  {
+  }
+
+uint64_t
+ScoreMemo::key(NameId stringA, NameId stringB)
+  {
+    return (stringA < stringB)
+        ? ((uint64_t) stringA << 32) | stringB
+        : ((uint64_t) stringB << 32) | stringA;
+  }
+
+size_t
+ScoreMemo::slot(uint64_t key) const
+  {
+    size_t mask = keys.size() - 1;
+    size_t s = (size_t) ((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+    while (keys[s] != EmptyKey && keys[s] != key)
+        s = (s + 1) & mask;
+    return s;
+  }
+
+bool
+ScoreMemo::lookup(uint64_t key, float& similarity) const
+  {
+    size_t s = slot(key);
+    if (keys[s] == EmptyKey)
+        return false;
+
+    similarity = values[s];
+    return true;
+  }
+
+void
+ScoreMemo::insert(uint64_t key, float similarity)
+  {
+    if (full())
+        return;
+
+    size_t s = slot(key);
+    if (keys[s] == EmptyKey)
+      {
+        keys[s] = key;
+        values[s] = similarity;
+
+     // Keep the load factor below one half.
+        if (2 * ++entries > keys.size())
+            rehash();
+      }
+  }
+
+void
+ScoreMemo::rehash()
+  {
+    vector<uint64_t> oldKeys(keys.size() * 2, EmptyKey);
+    vector<float>    oldValues(values.size() * 2);
+    oldKeys.swap(keys);
+    oldValues.swap(values);
+
+    for (size_t k = 0; k < oldKeys.size(); ++k)
+      {
+        if (oldKeys[k] != EmptyKey)
+          {
+            size_t s = slot(oldKeys[k]);
+            keys[s] = oldKeys[k];
+            values[s] = oldValues[k];
+          }
+      }
+  }
+
+/**
+ * A pair of similar names: their name table ids (first < second) and their
+ * similarity.  Scopes of many names have many more matches, so these are
+ * kept to 16 bytes, and copied as they are to and from a MatchSpill.
+ */
+class NameMatch
+  {
+    public:
+      NameId first;
+      NameId second;
+      float  similarity;
+      bool   canonical;  ///< The names have the same canonicalName() (see canonical_mode)
+
+      NameMatch(NameId first, NameId second, float similarity, bool canonical = false)
+        : first(first),
+          second(second),
+          similarity(similarity),
+          canonical(canonical)
+        {}
+
+      bool operator<(const NameMatch& other) const
+        {
+          return first < other.first || (first == other.first && second < other.second);
+        }
+  };
+
+/**
+ * The matches of the scopes that did not fit in the memory_budget, as runs
+ * of matches in name table order in a temporary file (deleted as it is
+ * closed).  Scorers may write runs concurrently; they are merged back into
+ * the order of a single sorted list by a MatchMerger.
+ */
+class MatchSpill
+  {
+    public:
+      /// Where a run is in the file, in matches.
+      class Run
+        {
+          public:
+            uint64_t offset;
+            uint64_t size;
+        };
+
+      MatchSpill();
+      ~MatchSpill();
+
+      /**
+       *  Sort the matches and append them to runs as a run of the file,
+       *  releasing their memory.  Exits if the file can't be written, the
+       *  report being incomplete otherwise.
+       */
+      void write(vector<NameMatch>& matches, vector<Run>& runs);
+
+      /**
+       *  Replace matches by up to count matches of the run, from its
+       *  begin-th on.
+       */
+      void read(const Run& run, uint64_t begin, size_t count, vector<NameMatch>& matches);
+
+    private:
+      FILE*           file;   ///< Created by the first write()
+      uint64_t        end;    ///< In matches
+      pthread_mutex_t lock;
+  };
+
+MatchSpill::MatchSpill()
+  : file(NULL),
+    end(0)
+  {
+    pthread_mutex_init(&lock, NULL);
+  }
+
+MatchSpill::~MatchSpill()
+  {
+    if (file != NULL)
+        fclose(file);
+    pthread_mutex_destroy(&lock);
+  }
+
+void
+MatchSpill::write(vector<NameMatch>& matches, vector<Run>& runs)
+  {
+    if (matches.empty())
+        return;
+
+    sort(matches.begin(), matches.end());
+
+    pthread_mutex_lock(&lock);
+    if (file == NULL)
+        file = tmpfile();
+
+    Run run;
+    run.offset = end;
+    run.size   = matches.size();
+
+    bool written = file != NULL &&
+                   fseeko(file, (off_t) (end * sizeof(NameMatch)), SEEK_SET) == 0 &&
+                   fwrite(&matches[0], sizeof(NameMatch), matches.size(), file) == matches.size();
+    end += matches.size();
+    pthread_mutex_unlock(&lock);
+
+    if (written == false)
+    {
+        fprintf(stderr, "Error: could not spill the matches to a temporary file\n");
+        exit(1);
+    }
+
+    runs.push_back(run);
+    vector<NameMatch>().swap(matches);
+  }
+
+void
+MatchSpill::read(const Run& run, uint64_t begin, size_t count, vector<NameMatch>& matches)
+  {
+    count = (size_t) min((uint64_t) count, run.size - begin);
+    matches.assign(count, NameMatch(0, 0, 0));
+
+    pthread_mutex_lock(&lock);
+    bool read = count == 0 ||
+                (fseeko(file, (off_t) ((run.offset + begin) * sizeof(NameMatch)), SEEK_SET) == 0 &&
+                 fread(&matches[0], sizeof(NameMatch), count, file) == count);
+    pthread_mutex_unlock(&lock);
+
+    if (read == false)
+    {
+        fprintf(stderr, "Error: could not read the matches back from a temporary file\n");
+        exit(1);
+    }
+  }
+
+/**
+ * The merge of the runs of a scope in a MatchSpill with its matches still
+ * in memory (sorted), a chunk at a time with the least of the next
+ * matches of each on a heap, holding ChunkSize matches of each run.
+ */
+class MatchMerger
+  {
+    public:
+      static const size_t ChunkSize = 4096;
+
+      MatchMerger(MatchSpill& spill, const vector<MatchSpill::Run>& runs, vector<NameMatch>& matches);
+
+      /**
+       *  Replace chunk by the next (up to ChunkSize) matches in name table
+       *  order, \return false if there are none left.
+       */
+      bool next(vector<NameMatch>& chunk);
+
+    private:
+      /// The key of the heap (smallest first) for the next match of a source.
+      typedef pair<uint64_t, size_t> Head;
+
+      void push(size_t source);
+
+      MatchSpill&                  spill;
+      vector<MatchSpill::Run>      runs;
+      vector< vector<NameMatch> >  buffers;   ///< Of the runs, then the matches in memory
+      vector<size_t>               positions; ///< In the buffers
+      vector<uint64_t>             consumed;  ///< Of the runs, read into the buffers
+      vector<Head>                 heap;
+  };
+
+const size_t MatchMerger::ChunkSize;
+
+MatchMerger::MatchMerger(MatchSpill& spill, const vector<MatchSpill::Run>& runs,
+                         vector<NameMatch>& matches)
+  : spill(spill),
+    runs(runs),
+    buffers(runs.size() + 1),
+    positions(runs.size() + 1, 0),
+    consumed(runs.size(), 0)
+  {
+    buffers[runs.size()].swap(matches);
+
+    for (size_t source = 0; source < buffers.size(); ++source)
+        push(source);
+  }
+
+void
+MatchMerger::push(size_t source)
+  {
+    if (source < runs.size() && positions[source] == buffers[source].size())
+    {
+        spill.read(runs[source], consumed[source], ChunkSize, buffers[source]);
+        consumed[source] += buffers[source].size();
+        positions[source] = 0;
+    }
+
+    if (positions[source] == buffers[source].size())
+        return;
+
+    const NameMatch& match = buffers[source][positions[source]];
+    heap.push_back(Head(((uint64_t) match.first << 32) | match.second, source));
+    push_heap(heap.begin(), heap.end(), greater<Head>());
+  }
+
+bool
+MatchMerger::next(vector<NameMatch>& chunk)
+  {
+    chunk.clear();
+    while (chunk.size() < ChunkSize && heap.empty() == false)
+    {
+        pop_heap(heap.begin(), heap.end(), greater<Head>());
+        size_t source = heap.back().second;
+        heap.pop_back();
+
+        chunk.push_back(buffers[source][positions[source]++]);
+        push(source);
+    }
+
+    return chunk.empty() == false;
+  }
+
+/**
+ *  This is used to pass context down in the AST traversal (but not required).
+ */
+class InheritedAttribute
+  {
+  };
+
+/**
+ * This is used to pass information up in the AST traversal.
+ *
+ * The names collected in the subtree are the NameTable ids [begin, end).
+ */
+class SynthesizedAttribute
+  {
+    public:
+      NameId begin;
+      NameId end;
+
+      SynthesizedAttribute() : begin(0), end(0) {}
+
+      bool empty() const { return begin == end; }
+  };
+
+/**
+ * What the index keeps of an input file parsed in this run (see
+ * SimilarityIndex): the names collected from its translation unit, the files
+ * they depend on, and its report.
+ */
+class IndexRecord
+  {
+    public:
+      string      path;          ///< The input file, as given on the command line
+      bool        traversed;     ///< Whether the traversal reached its SgSourceFile
+      const NameTable* nameTable; ///< Where its names are: the ids [namesBegin, namesEnd)
+      NameId      namesBegin;
+      NameId      namesEnd;
+      set<string> dependencies;  ///< The files of the nodes of its AST
+      string      report;
+
+      IndexRecord(const string& path)
+        : path(path),
+          traversed(false),
+          nameTable(NULL),
+          namesBegin(0),
+          namesEnd(0)
+        {}
+  };
+
+/**
+ * Add the files that fileName includes to files, and those they include in
+ * turn, as found by their #include directives in the directory of the
+ * including file (for the quoted ones), the includePaths and the system
+ * directories.  Whether or not the traversal visits them: a header that
+ * only defines macros, or one left out by input_files_only, changes the
+ * report as much as any other.
+ */
+void
+addIncludedFiles(const string& fileName, const vector<string>& includePaths, set<string>& files)
+  {
+    static const char* systemPaths[] = { "/usr/local/include", "/usr/include", NULL };
+
+    FILE* file = fopen(fileName.c_str(), "r");
+    if (file == NULL)
+        return;
+
+    vector<string> included;
+    vector<bool>   quoted;
+
+    char line[4096];
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        const char* c = line;
+        while (*c == ' ' || *c == '\t')
+            ++c;
+        if (*c++ != '#')
+            continue;
+        while (*c == ' ' || *c == '\t')
+            ++c;
+        if (strncmp(c, "include", 7) != 0)
+            continue;
+        c += 7;
+        while (*c == ' ' || *c == '\t')
+            ++c;
+
+        char close = (*c == '"') ? '"' : (*c == '<') ? '>' : 0;
+        const char* end = (close != 0) ? strchr(c + 1, close) : NULL;
+        if (end == NULL)
+            continue;
+
+        included.push_back(string(c + 1, end));
+        quoted.push_back(close == '"');
+    }
+    fclose(file);
+
+    string directory = fileName.substr(0, fileName.rfind('/') + 1);
+
+    for (size_t k = 0; k < included.size(); ++k)
+    {
+        vector<string> candidates;
+        if (quoted[k])
+            candidates.push_back(directory + included[k]);
+        for (size_t i = 0; i < includePaths.size(); ++i)
+            candidates.push_back(includePaths[i] + "/" + included[k]);
+        for (size_t i = 0; systemPaths[i] != NULL; ++i)
+            candidates.push_back(string(systemPaths[i]) + "/" + included[k]);
+
+        for (size_t i = 0; i < candidates.size(); ++i)
+        {
+            char path[PATH_MAX];
+            if (realpath(candidates[i].c_str(), path) == NULL)
+                continue;
+
+            if (files.insert(path).second)
+                addIncludedFiles(path, includePaths, files);
+            break;
+        }
+    }
+  }
+
+/**
+ * A file mapped read-only into memory.
+ */
+class MappedFile
+  {
+    public:
+      MappedFile() : data(NULL), size(0) {}
+      ~MappedFile() { unmap(); }
+
+      /**
+       *  \return false if fileName can't be mapped (or is empty).
+       */
+      bool map(const string& fileName);
+      void unmap();
+
+      const char* data;
+      size_t      size;
+
+    private:
+      MappedFile(const MappedFile &);             // not copyable
+      MappedFile & operator=(const MappedFile &);
+  };
+
+bool
+MappedFile::map(const string& fileName)
+  {
+    unmap();
+
+    int descriptor = open(fileName.c_str(), O_RDONLY);
+    if (descriptor < 0)
+        return false;
+
+    struct stat status;
+    if (fstat(descriptor, &status) != 0 || status.st_size == 0)
+    {
+        close(descriptor);
+        return false;
+    }
+
+    void* mapping = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    close(descriptor);
+
+    if (mapping == MAP_FAILED)
+        return false;
+
+    data = (const char*) mapping;
+    size = status.st_size;
+    return true;
+  }
+
+void
+MappedFile::unmap()
+  {
+    if (data != NULL)
+        munmap((void*) data, size);
+
+    data = NULL;
+    size = 0;
+  }
+
+/**
+ * Bounds checked reading of the fields of a SimilarityIndex.
+ */
+class IndexReader
+  {
+    public:
+      IndexReader(const char* begin, const char* end)
+        : position(begin),
+          end(end),
+          valid(true)
+        {}
+
+      uint32_t get32() { uint32_t value = 0; read(&value, sizeof(value)); return value; }
+      uint64_t get64() { uint64_t value = 0; read(&value, sizeof(value)); return value; }
+
+      /**
+       *  Read a string in place: \return its first character (length in size).
+       */
+      const char* getBytes(uint32_t& size)
+        {
+          size = get32();
+          const char* bytes = position;
+          skip(size);
+          return bytes;
+        }
+
+      string getString()
+        {
+          uint32_t size;
+          const char* bytes = getBytes(size);
+          return valid ? string(bytes, size) : string();
+        }
+
+      void skip(size_t size)
+        {
+          if (valid && (size_t) (end - position) >= size)
+              position += size;
+          else
+              valid = false;
+        }
+
+      const char* position;
+      const char* end;
+      bool        valid;   ///< False once a read overran the end
+
+    private:
+      void read(void* value, size_t size)
+        {
+          const char* bytes = position;
+          skip(size);
+          if (valid)
+              memcpy(value, bytes, size);
+        }
+  };
+
+/**
+ * Accumulates the fields of a SimilarityIndex.
+ */
+class IndexWriter
+  {
+    public:
+      void put32(uint32_t value) { buffer.append((const char*) &value, sizeof(value)); }
+      void put64(uint64_t value) { buffer.append((const char*) &value, sizeof(value)); }
+
+      void putString(const char* bytes, size_t size)
+        {
+          put32(size);
+          buffer.append(bytes, size);
+        }
+
+      void putString(const string& s) { putString(s.data(), s.size()); }
+
+      string buffer;
+  };
+
+/**
+ * The persistent index of --index=FILE, for reruns on mostly unchanged code.
+ *
+ * For each input file it keeps the hash of its contents, the files its AST
+ * depends on (with the hashes of their contents), the names collected from
+ * it and its report.  An input file whose dependencies are all unchanged is
+ * not parsed again: its report is replayed straight from the memory mapped
+ * index.  The index is only used if it was built with the same options.
+ *
+ * Layout (native byte order, strings as a uint32_t length and the bytes):
+ *
+ *   "UVNINDEX", uint32_t Version, uint32_t number of entries,
+ *   uint64_t configuration hash, then for each entry:
+ *
+ *     string path, uint64_t hash of its contents,
+ *     uint32_t number of dependencies, { string path, uint64_t hash },
+ *     uint32_t number of names, { string name, string kind (class name of
+ *     the declaration), uint32_t line, uint32_t number of its dependency },
+ *     string report
+ */
+class SimilarityIndex
+  {
+    public:
+      static const uint32_t Version = 1;
+
+      /// Dependency number of the names not from a file.
+      static const uint32_t NoFile = ~(uint32_t) 0;
+
+      /// The configuration to load() any index with.
+      static const uint64_t AnyConfiguration = 0;
+
+      /**
+       *  An entry, pointing into the mapped index.
+       */
+      class Entry
+        {
+          public:
+            const char* begin;          ///< The entry is [begin, end)
+            const char* end;
+            uint64_t    hash;
+            const char* dependencies;   ///< The number of dependencies and what follows
+            const char* report;
+            uint32_t    reportSize;
+        };
+
+      /**
+       *  Map the index in fileName.  \return false if it is missing, invalid
+       *  or was built with another configuration (the index is empty then).
+       */
+      bool load(const string& fileName, uint64_t configuration);
+
+      /**
+       *  Add the names of all the entries to nameTable.
+       */
+      void addNames(NameTable& nameTable) const;
+
+      /**
+       *  \return the entry of the input file path if none of the files it
+       *  depends on changed since it was indexed, NULL otherwise.
+       */
+      const Entry* find(const string& path);
+
+      /**
+       *  Write the index of this run to fileName: the entries reused from the
+       *  loaded index, then the records of the files parsed in this run.
+       */
+      bool write(const string& fileName, uint64_t configuration,
+                 const vector<const Entry*>& reused,
+                 const vector<IndexRecord*>& records);
+
+    private:
+      uint64_t fileHash(const string& fileName);
+
+      void unload();
+
+      MappedFile            mapping;
+      map<string, Entry>    entries;
+      map<string, uint64_t> hashes;   ///< Of the files checked so far
+  };
+
+const uint32_t SimilarityIndex::Version;
+const uint32_t SimilarityIndex::NoFile;
+const uint64_t SimilarityIndex::AnyConfiguration;
+
+void
+SimilarityIndex::unload()
+  {
+    mapping.unmap();
+    entries.clear();
+  }
+
+uint64_t
+SimilarityIndex::fileHash(const string& fileName)
+  {
+    map<string, uint64_t>::iterator i = hashes.find(fileName);
+    if (i == hashes.end())
+        i = hashes.insert(make_pair(fileName, hashFileContents(fileName))).first;
+    return i->second;
+  }
+
+bool
+SimilarityIndex::load(const string& fileName, uint64_t configuration)
+  {
+    unload();
+
+    if (mapping.map(fileName) == false)
+        return false;
+
+    IndexReader in(mapping.data, mapping.data + mapping.size);
+
+    const char* magic = in.position;
+    in.skip(8);
+    bool compatible = in.valid && memcmp(magic, "UVNINDEX", 8) == 0
+                   && in.get32() == Version;
+
+    uint32_t numberOfEntries = in.get32();
+    uint64_t indexed = in.get64();
+    compatible = compatible && (configuration == AnyConfiguration || indexed == configuration);
+
+    for (uint32_t e = 0; e < numberOfEntries && compatible && in.valid; ++e)
+    {
+        Entry entry;
+        entry.begin = in.position;
+
+        string path = in.getString();
+        entry.hash = in.get64();
+
+        entry.dependencies = in.position;
+        uint32_t numberOfDependencies = in.get32();
+        for (uint32_t d = 0; d < numberOfDependencies && in.valid; ++d)
+        {
+            in.getString();
+            in.get64();
+        }
+
+        uint32_t numberOfNames = in.get32();
+        for (uint32_t k = 0; k < numberOfNames && in.valid; ++k)
+        {
+            in.getString();
+            in.getString();
+            in.get32();
+            in.get32();
+        }
+
+        entry.report = in.getBytes(entry.reportSize);
+        entry.end = in.position;
+
+        entries[path] = entry;
+    }
+
+    if (compatible == false || in.valid == false)
+    {
+        unload();
+        return false;
+    }
+
+    return true;
+  }
+
+void
+SimilarityIndex::addNames(NameTable& nameTable) const
+  {
+    map<string, Entry>::const_iterator e;
+    for (e = entries.begin(); e != entries.end(); ++e)
+    {
+        IndexReader in(e->second.dependencies, e->second.end);
+
+        vector<const char*> dependencies;
+        uint32_t numberOfDependencies = in.get32();
+        for (uint32_t d = 0; d < numberOfDependencies; ++d)
+        {
+            dependencies.push_back(nameTable.label(in.getString()));
+            in.get64();
+        }
+
+        uint32_t numberOfNames = in.get32();
+        for (uint32_t k = 0; k < numberOfNames && in.valid; ++k)
+        {
+            string name = in.getString();
+
+            Declaration declaration;
+            declaration.kind = nameTable.label(in.getString());
+            declaration.name = NULL;
+            declaration.line = in.get32();
+
+            uint32_t file = in.get32();
+            if (file < dependencies.size())
+                declaration.file = dependencies[file];
+
+            nameTable.add(name, declaration);
+        }
+    }
+  }
+
+const SimilarityIndex::Entry*
+SimilarityIndex::find(const string& path)
+  {
+    map<string, Entry>::iterator i = entries.find(path);
+    if (i == entries.end() || fileHash(path) != i->second.hash)
+        return NULL;
+
+    const Entry& entry = i->second;
+
+    IndexReader in(entry.dependencies, entry.end);
+    uint32_t numberOfDependencies = in.get32();
+    for (uint32_t d = 0; d < numberOfDependencies; ++d)
+    {
+        string dependency = in.getString();
+        if (fileHash(dependency) != in.get64())
+            return NULL;
+    }
+
+    return &entry;
+  }
+
+bool
+SimilarityIndex::write(const string& fileName, uint64_t configuration,
+                       const vector<const Entry*>& reused,
+                       const vector<IndexRecord*>& records)
+  {
+    IndexWriter out;
+    out.buffer.append("UVNINDEX", 8);
+    out.put32(Version);
+    out.put32(0);
+    out.put64(configuration);
+
+    uint32_t numberOfEntries = 0;
+
+    for (size_t e = 0; e < reused.size(); ++e)
+    {
+        out.buffer.append(reused[e]->begin, reused[e]->end - reused[e]->begin);
+        ++numberOfEntries;
+    }
+
+    for (size_t r = 0; r < records.size(); ++r)
+    {
+        const IndexRecord& record = *records[r];
+        if (record.traversed == false)
+            continue;
+
+        out.putString(record.path);
+        out.put64(fileHash(record.path));
+
+        map<string, uint32_t> dependencyNumber;
+        out.put32(record.dependencies.size());
+
+        set<string>::const_iterator d;
+        for (d = record.dependencies.begin(); d != record.dependencies.end(); ++d)
+        {
+            uint32_t number = dependencyNumber.size();
+            dependencyNumber[*d] = number;
+
+            out.putString(*d);
+            out.put64(fileHash(*d));
+        }
+
+        out.put32(record.namesEnd - record.namesBegin);
+        for (NameId k = record.namesBegin; k != record.namesEnd; ++k)
+        {
+            const NameStructureType& name = (*record.nameTable)[k];
+
+            map<string, uint32_t>::iterator file = dependencyNumber.find(name.declaration.file);
+
+            out.putString(name.c_str(), name.size());
+            out.putString(name.declaration.kind);
+            out.put32(name.declaration.line);
+            out.put32(file != dependencyNumber.end() ? file->second : NoFile);
+        }
+
+        out.putString(record.report);
+        ++numberOfEntries;
+    }
+
+    memcpy(&out.buffer[12], &numberOfEntries, sizeof(numberOfEntries));
+
+    // Replace the index in one step, so that an interrupted run leaves the
+    // previous one (which may still be mapped) intact.
+    string temporary = fileName + ".tmp";
+
+    FILE* file = fopen(temporary.c_str(), "wb");
+    if (file == NULL)
+        return false;
+
+    bool written = fwrite(out.buffer.data(), 1, out.buffer.size(), file) == out.buffer.size();
+    written = fclose(file) == 0 && written;
+
+    if (written == false || rename(temporary.c_str(), fileName.c_str()) != 0)
+    {
+        remove(temporary.c_str());
+        return false;
+    }
+
+    return true;
+  }
+
+/**
+ * The names of a SimilarityIndex, loaded once to answer queries for the
+ * names most similar to a given one (see runQueries()) without running the
+ * frontend.  The distinct strings are kept by length, so that a query only
+ * visits the lengths that can exceed its threshold, and the histograms of
+ * the strings are checked before any of them is scored.
+ */
+class NameQuery
+  {
+    public:
+      /**
+       *  A string similar to the one queried.
+       */
+      class Result
+        {
+          public:
+            NameId stringId;
+            float  similarity;
+
+            Result(NameId stringId, float similarity)
+              : stringId(stringId),
+                similarity(similarity)
+              {}
+
+            /// The most similar first (then by stringId).
+            bool operator<(const Result& other) const
+              {
+                if (similarity != other.similarity)
+                    return similarity > other.similarity;
+                return stringId < other.stringId;
+              }
+        };
+
+      /**
+       *  Load the names of the index in fileName (whatever the configuration
+       *  it was built with).  \return false if it is missing or invalid.
+       */
+      bool load(const string& fileName);
+
+      /**
+       *  Put in results the strings (other than name) more than threshold
+       *  similar to name, of which some occurrence is declared in a file
+       *  whose path starts with scope; the most similar first, and at most
+       *  limit of them unless it is 0.  Once limit strings are found, the
+       *  threshold rises to the similarity of the least similar of them.
+       */
+      void find(const string& name, const string& scope, float threshold, size_t limit,
+                vector<Result>& results) const;
+
+      /**
+       *  \return whether some occurrence of the string is declared in a file
+       *  whose path starts with scope.
+       */
+      bool inScope(NameId stringId, const string& scope) const;
+
+      NameTable nameTable;
+
+      /// The occurrences of each string s are those of
+      /// [occurrenceStart[s], occurrenceStart[s + 1]).
+      vector<NameId> occurrenceStart;
+      vector<NameId> occurrences;
+
+    private:
+      /// The strings of each length l are those of
+      /// [lengthStart[l], lengthStart[l + 1]) in byLength.
+      vector<NameId> lengthStart;
+      vector<NameId> byLength;
+  };
+
+bool
+NameQuery::load(const string& fileName)
+  {
+    SimilarityIndex index;
+    if (index.load(fileName, SimilarityIndex::AnyConfiguration) == false)
+        return false;
+
+    index.addNames(nameTable);
+
+    // The occurrences of each string (as mergeShards() has them).
+    NameId numberOfStrings = nameTable.numberOfStrings();
+    occurrenceStart.assign(numberOfStrings + 1, 0);
+    for (NameId k = 0; k < nameTable.size(); ++k)
+        ++occurrenceStart[nameTable[k].stringId + 1];
+
+    for (NameId s = 0; s < numberOfStrings; ++s)
+        occurrenceStart[s + 1] += occurrenceStart[s];
+
+    occurrences.resize(nameTable.size());
+    vector<NameId> next(occurrenceStart.begin(), occurrenceStart.end() - 1);
+    for (NameId k = 0; k < nameTable.size(); ++k)
+        occurrences[next[nameTable[k].stringId]++] = k;
+
+    // And the strings by length.
+    uint32_t maxLength = 0;
+    for (NameId s = 0; s < numberOfStrings; ++s)
+        maxLength = max(maxLength, nameTable.stringLength(s));
+
+    lengthStart.assign(maxLength + 2, 0);
+    for (NameId s = 0; s < numberOfStrings; ++s)
+        ++lengthStart[nameTable.stringLength(s) + 1];
+
+    for (uint32_t l = 0; l <= maxLength; ++l)
+        lengthStart[l + 1] += lengthStart[l];
+
+    byLength.resize(numberOfStrings);
+    next.assign(lengthStart.begin(), lengthStart.end() - 1);
+    for (NameId s = 0; s < numberOfStrings; ++s)
+        byLength[next[nameTable.stringLength(s)]++] = s;
+
+    return true;
+  }
+
+bool
+NameQuery::inScope(NameId stringId, const string& scope) const
+  {
+    for (NameId k = occurrenceStart[stringId]; k != occurrenceStart[stringId + 1]; ++k)
+    {
+        if (strncmp(nameTable[occurrences[k]].declaration.file, scope.c_str(), scope.size()) == 0)
+            return true;
+    }
+
+    return false;
+  }
+
+void
+NameQuery::find(const string& name, const string& scope, float threshold, size_t limit,
+                vector<Result>& results) const
+  {
+    results.clear();
+
+    size_t length = name.size();
+    if (length == 0 || lengthStart.size() < 2)
+        return;
+
+    Scorer& scorer = Scorer::threadLocal();
+
+    NameSignature signature;
+    signature.assign(name.c_str(), length);
+
+    // The lengths closest to that of the name first: the bound of the
+    // similarity of the lengths only drops farther away from it.
+    size_t maxLength = lengthStart.size() - 2;
+    for (size_t distance = 0; ; ++distance)
+    {
+        bool reachable = false;
+
+        for (int side = 0; side < 2; ++side)
+        {
+            if (side == 1 && distance == 0)
+                break;
+            if (side == 0 && distance >= length)
+                continue;
+
+            size_t other   = (side == 0) ? length - distance : length + distance;
+            size_t shorter = min(length, other);
+            size_t longer  = max(length, other);
+            if (scorer.lengthBound(shorter, longer) <= threshold)
+                continue;
+
+            // No string is longer than maxLength, but shorter ones may be.
+            if (other > maxLength)
+            {
+                reachable = reachable || side == 0;
+                continue;
+            }
+
+            reachable = true;
+
+            for (NameId k = lengthStart[other]; k != lengthStart[other + 1]; ++k)
+            {
+                NameId      stringId = byLength[k];
+                const char* text     = nameTable.stringOf(stringId);
+
+                if (other == length && memcmp(text, name.c_str(), length) == 0)
+                    continue;
+
+                if (longer <= NameSignature::MaxLength)
+                {
+                    size_t common = signature.commonCharacters(nameTable.signature(stringId));
+                    if (scorer.commonBound(common, shorter, longer) <= threshold)
+                        continue;
+                }
+
+                if (scope.empty() == false && inScope(stringId, scope) == false)
+                    continue;
+
+                float similarity = scorer.similarityAbove(name.c_str(), length, text, other, threshold);
+                if (similarity <= threshold)
+                    continue;
+
+                // With a limit, results is a heap with the least similar first.
+                results.push_back(Result(stringId, similarity));
+                if (limit != 0)
+                {
+                    push_heap(results.begin(), results.end());
+                    if (results.size() > limit)
+                    {
+                        pop_heap(results.begin(), results.end());
+                        results.pop_back();
+                    }
+
+                    if (results.size() == limit)
+                        threshold = max(threshold, results.front().similarity);
+                }
+            }
+        }
+
+        if (reachable == false)
+            break;
+    }
+
+    sort(results.begin(), results.end());
+  }
+
+/**
+ * The names of a project as extracted from its AST, in traversal order:
+ * written by --emit-names=FILE, and scored by --names=FILE without running
+ * the frontend again.
+ *
+ * Layout (native byte order, strings as in SimilarityIndex):
+ *
+ *   "UVNNAMES", uint32_t Version, then a sequence of events:
+ *
+ *     'N' string name, uint32_t NameKind, declaration
+ *                                        a name was collected
+ *     'S' uint32_t n, declaration        the scope of the last n names ended
+ *
+ *   with a declaration being uint64_t node, string kind, string name,
+ *   string file, uint32_t line.
+ */
+class NameStream
+  {
+    public:
+      static const uint32_t Version = 2;
+      static const char NameEvent  = 'N';
+      static const char ScopeEvent = 'S';
+
+      NameStream() : file(NULL), failed(false) {}
+      ~NameStream() { close(); }
+
+      /**
+       *  Start writing the stream to fileName (until then, the events are
+       *  kept in memory, for takeEvents()).
+       */
+      bool open(const string& fileName);
+
+      /**
+       *  Move the events so far (of a stream kept in memory) to events.
+       */
+      void takeEvents(string& events);
+
+      /**
+       *  \return false if the stream could not be written completely.
+       */
+      bool close();
+
+      void addName(const NameStructureType& name);
+      void endScope(uint32_t numberOfNames, const Declaration& scope);
+
+      static void putDeclaration(IndexWriter& out, const Declaration& declaration);
+
+      /**
+       *  \return the declaration read from in, its strings owned by nameTable
+       *  (its name is NULL if it is the given name, as for NameTable::add).
+       */
+      static Declaration getDeclaration(IndexReader& in, NameTable& nameTable,
+                                        const string* name = NULL);
+
+    private:
+      NameStream(const NameStream &);             // not copyable
+      NameStream & operator=(const NameStream &);
+
+      void flush();
+
+      static const size_t BufferSize = 1024 * 1024;
+
+      FILE*       file;
+      IndexWriter out;
+      bool        failed;
+  };
+
+const uint32_t NameStream::Version;
+const char NameStream::NameEvent;
+const char NameStream::ScopeEvent;
+const size_t NameStream::BufferSize;
+
+bool
+NameStream::open(const string& fileName)
+  {
+    close();
+
+    file = fopen(fileName.c_str(), "wb");
+    if (file == NULL)
+        return false;
+
+    failed = false;
+    out.buffer.append("UVNNAMES", 8);
+    out.put32(Version);
+    return true;
+  }
+
+void
+NameStream::flush()
+  {
+    if (fwrite(out.buffer.data(), 1, out.buffer.size(), file) != out.buffer.size())
+        failed = true;
+    out.buffer.clear();
+  }
+
+void
+NameStream::takeEvents(string& events)
+  {
+    events.swap(out.buffer);
+    out.buffer.clear();
+  }
+
+bool
+NameStream::close()
+  {
+    if (file == NULL)
+        return true;
+
+    flush();
+    failed = fclose(file) != 0 || failed;
+    file = NULL;
+    return failed == false;
+  }
+
+void
+NameStream::putDeclaration(IndexWriter& out, const Declaration& declaration)
+  {
+    out.put64((uintptr_t) declaration.node);
+    out.putString(declaration.kind, strlen(declaration.kind));
+    out.putString(declaration.name, strlen(declaration.name));
+    out.putString(declaration.file, strlen(declaration.file));
+    out.put32(declaration.line);
+  }
+
+Declaration
+NameStream::getDeclaration(IndexReader& in, NameTable& nameTable, const string* name)
+  {
+    Declaration declaration;
+    declaration.node = (const void*) (uintptr_t) in.get64();
+    declaration.kind = nameTable.label(in.getString());
+
+    // A name is mostly declared as itself (see NameTable::add).
+    string declaredName = in.getString();
+    declaration.name = name != NULL && declaredName == *name ? NULL : nameTable.label(declaredName);
+
+    declaration.file = nameTable.label(in.getString());
+    declaration.line = in.get32();
+    return declaration;
+  }
+
+void
+NameStream::addName(const NameStructureType& name)
+  {
+    out.buffer += NameEvent;
+    out.putString(name.c_str(), name.size());
+    out.put32(name.kind);
+    putDeclaration(out, name.declaration);
+
+    if (file != NULL && out.buffer.size() >= BufferSize)
+        flush();
+  }
+
+void
+NameStream::endScope(uint32_t numberOfNames, const Declaration& scope)
+  {
+    out.buffer += ScopeEvent;
+    out.put32(numberOfNames);
+    putDeclaration(out, scope);
+
+    if (file != NULL && out.buffer.size() >= BufferSize)
+        flush();
+  }
+
+/**
+ * The plan of a sharded comparison of all the names of a code base as a
+ * single scope, too many for one process (see --shard-plan).
+ *
+ * The distinct strings of the names are sorted by length and cut into
+ * chunks, the pairs of strings into the blocks of pairs of chunks (I, J),
+ * I <= J, which workers score independently.  Since a string can only be
+ * similar to one close enough in length, the blocks of chunks too far
+ * apart in length are not even planned.
+ *
+ * Layout of the table file (native byte order, strings as in
+ * SimilarityIndex):
+ *
+ *   "UVNSHARD", uint32_t Version, float similarity_threshold, uint32_t Metric,
+ *   uint32_t number of strings, { string },
+ *   uint32_t number of chunks, { uint32_t first string of the chunk },
+ *   uint32_t number of blocks, { uint32_t I, uint32_t J }
+ *
+ * and of the results of block K, in the file of the table followed by ".K":
+ *
+ *   "UVNBLOCK", uint32_t Version, uint32_t K,
+ *   uint32_t number of matches, { uint32_t string, uint32_t string, float similarity }
+ */
+class ShardTable
+  {
+    public:
+      static const uint32_t Version = 2;
+
+      class Match
+        {
+          public:
+            uint32_t first;
+            uint32_t second;
+            float    similarity;
+        };
+
+      /**
+       *  Plan numberOfChunks chunks of the strings.
+       */
+      void plan(const vector<string>& strings, unsigned numberOfChunks);
+
+      bool read(const string& fileName);
+      bool write(const string& fileName) const;
+
+      /**
+       *  \return the name of the file of the results of block K.
+       */
+      static string blockFileName(const string& fileName, unsigned block);
+
+      static bool readBlock(const string& fileName, unsigned block, vector<Match>& matches);
+      static bool writeBlock(const string& fileName, unsigned block, const vector<Match>& matches);
+
+      /// The strings of chunk I are [chunkBegin[I], chunkBegin[I + 1]).
+      vector<string>   strings;
+      vector<uint32_t> chunkBegin;
+      vector< pair<uint32_t,uint32_t> > blocks;
+      float            threshold;
+      Metric           metric;
+  };
+
+const uint32_t ShardTable::Version;
+
+/**
+ * \return true if a is shorter than b, or as long and before b.
+ */
+bool
+shorterString(const string& a, const string& b)
+  {
+    return a.size() < b.size() || (a.size() == b.size() && a < b);
+  }
+
+void
+ShardTable::plan(const vector<string>& names, unsigned numberOfChunks)
+  {
+    strings = names;
+    sort(strings.begin(), strings.end(), shorterString);
+
+    threshold = similarity_threshold;
+    metric    = similarity_metric;
+
+    size_t numberOfStrings = strings.size();
+    if (numberOfChunks > numberOfStrings)
+        numberOfChunks = numberOfStrings;
+
+    chunkBegin.clear();
+    for (unsigned I = 0; I <= numberOfChunks; ++I)
+        chunkBegin.push_back(numberOfChunks == 0 ? 0 : (uint32_t) (numberOfStrings * I / numberOfChunks));
+
+    // The longest string of chunk I against the shortest of chunk J is the
+    // pair of the block closest in length (see ScopeScorer::scoreNames()).
+    blocks.clear();
+    for (unsigned I = 0; I < numberOfChunks; ++I)
+    {
+        size_t longest = strings[chunkBegin[I + 1] - 1].size();
+        for (unsigned J = I; J < numberOfChunks; ++J)
+        {
+            size_t shortest = strings[chunkBegin[J]].size();
+            if (J == I || Scorer::threadLocal().lengthBound(longest, shortest) >= threshold)
+                blocks.push_back(make_pair(I, J));
+        }
+    }
+  }
+
+bool
+ShardTable::write(const string& fileName) const
+  {
+    IndexWriter out;
+    out.buffer.append("UVNSHARD", 8);
+    out.put32(Version);
+    out.buffer.append((const char*) &threshold, sizeof(threshold));
+    out.put32(metric);
+
+    out.put32(strings.size());
+    for (size_t k = 0; k < strings.size(); ++k)
+        out.putString(strings[k]);
+
+    out.put32(chunkBegin.size());
+    for (size_t I = 0; I < chunkBegin.size(); ++I)
+        out.put32(chunkBegin[I]);
+
+    out.put32(blocks.size());
+    for (size_t b = 0; b < blocks.size(); ++b)
+    {
+        out.put32(blocks[b].first);
+        out.put32(blocks[b].second);
+    }
+
+    FILE* file = fopen(fileName.c_str(), "wb");
+    if (file == NULL)
+        return false;
+
+    bool written = fwrite(out.buffer.data(), 1, out.buffer.size(), file) == out.buffer.size();
+    return fclose(file) == 0 && written;
+  }
+
+bool
+ShardTable::read(const string& fileName)
+  {
+    MappedFile mapping;
+    if (mapping.map(fileName) == false)
+        return false;
+
+    IndexReader in(mapping.data, mapping.data + mapping.size);
+
+    const char* magic = in.position;
+    in.skip(8);
+    if (in.valid == false || memcmp(magic, "UVNSHARD", 8) != 0 || in.get32() != Version)
+        return false;
+
+    uint32_t bits = in.get32();
+    memcpy(&threshold, &bits, sizeof(threshold));
+
+    uint32_t metricNumber = in.get32();
+    if (metricNumber >= NumberOfMetrics)
+        return false;
+    metric = (Metric) metricNumber;
+
+    strings.resize(in.get32());
+    for (size_t k = 0; k < strings.size() && in.valid; ++k)
+        strings[k] = in.getString();
+
+    chunkBegin.resize(in.get32());
+    for (size_t I = 0; I < chunkBegin.size() && in.valid; ++I)
+        chunkBegin[I] = in.get32();
+
+    // The chunks are consecutive ranges covering all the strings.
+    if (in.valid == false || chunkBegin.empty() || chunkBegin.front() != 0
+        || chunkBegin.back() != strings.size())
+        return false;
+
+    for (size_t I = 1; I < chunkBegin.size(); ++I)
+    {
+        if (chunkBegin[I] < chunkBegin[I - 1])
+            return false;
+    }
+
+    blocks.resize(in.get32());
+    for (size_t b = 0; b < blocks.size() && in.valid; ++b)
+    {
+        blocks[b].first  = in.get32();
+        blocks[b].second = in.get32();
+        if (blocks[b].first > blocks[b].second || blocks[b].second >= chunkBegin.size() - 1)
+            return false;
+    }
+
+    return in.valid;
+  }
+
+string
+ShardTable::blockFileName(const string& fileName, unsigned block)
+  {
+    char suffix[16];
+    sprintf(suffix, ".%u", block);
+    return fileName + suffix;
+  }
+
+bool
+ShardTable::writeBlock(const string& fileName, unsigned block, const vector<Match>& matches)
+  {
+    IndexWriter out;
+    out.buffer.append("UVNBLOCK", 8);
+    out.put32(Version);
+    out.put32(block);
+    out.put32(matches.size());
+
+    for (size_t m = 0; m < matches.size(); ++m)
+    {
+        out.put32(matches[m].first);
+        out.put32(matches[m].second);
+        out.buffer.append((const char*) &matches[m].similarity, sizeof(float));
+    }
+
+    FILE* file = fopen(blockFileName(fileName, block).c_str(), "wb");
+    if (file == NULL)
+        return false;
+
+    bool written = fwrite(out.buffer.data(), 1, out.buffer.size(), file) == out.buffer.size();
+    return fclose(file) == 0 && written;
+  }
+
+bool
+ShardTable::readBlock(const string& fileName, unsigned block, vector<Match>& matches)
+  {
+    MappedFile mapping;
+    if (mapping.map(blockFileName(fileName, block)) == false)
+        return false;
+
+    IndexReader in(mapping.data, mapping.data + mapping.size);
+
+    const char* magic = in.position;
+    in.skip(8);
+    if (in.valid == false || memcmp(magic, "UVNBLOCK", 8) != 0 || in.get32() != Version
+        || in.get32() != block)
+        return false;
+
+    uint32_t numberOfMatches = in.get32();
+    for (uint32_t m = 0; m < numberOfMatches && in.valid; ++m)
+    {
+        Match match;
+        match.first  = in.get32();
+        match.second = in.get32();
+
+        uint32_t bits = in.get32();
+        memcpy(&match.similarity, &bits, sizeof(float));
+
+        if (in.valid)
+            matches.push_back(match);
+    }
+
+    return in.valid;
+  }
+
+/**
+ * The output of the report, buffered so that it is written in large
+ * blocks however small the pieces it is given.  In the SARIF format every
+ * line given is a result (see Traversal::reportMatches()), and the writer
+ * adds the rest of the log around them.
+ */
+class ReportWriter
+  {
+    public:
+      static const size_t BufferSize = 1 << 20;
+
+      ReportWriter() : file(NULL), results(0), failed(false) {}
+
+      /**
+       * Start the report in fileName (standard output if empty).
+       */
+      bool open(const string& fileName);
+
+      void write(const char* text, size_t size);
+      void write(const string& text) { write(text.data(), text.size()); }
+
+      /**
+       * Finish the report, \return false if any of it could not be written.
+       */
+      bool close();
+
+    private:
+      void flush();
+
+      FILE*  file;
+      string buffer;
+      size_t results;
+      bool   failed;
+  };
+
+const size_t ReportWriter::BufferSize;
+
+ReportWriter reportWriter;
+
+bool
+ReportWriter::open(const string& fileName)
+  {
+    file = fileName.empty() ? stdout : fopen(fileName.c_str(), "wb");
+    if (file == NULL)
+        return false;
+
+    buffer.reserve(BufferSize + BufferSize / 4);
+
+    if (report_format == SarifReport)
+    {
+        buffer += "{\"version\":\"2.1.0\","
+                  "\"$schema\":\"https://json.schemastore.org/sarif-2.1.0.json\","
+                  "\"runs\":[{\"tool\":{\"driver\":{\"name\":\"unique_variable_names\","
+                  "\"rules\":[{\"id\":\"similar-names\","
+                  "\"shortDescription\":{\"text\":\"Similar names of user defined language constructs\"}}]}},"
+                  "\"results\":[\n";
+    }
+
+    return true;
+  }
+
+void
+ReportWriter::write(const char* text, size_t size)
+  {
+    if (file == NULL)
+        return;
+
+    if (report_format == SarifReport)
+    {
+        // The results are separated by commas.
+        const char* end = text + size;
+        while (text != end)
+        {
+            const char* line = text;
+            text = (const char*) memchr(line, '\n', end - line);
+            text = (text == NULL) ? end : text + 1;
+
+            if (results++ > 0)
+                buffer += ',';
+            buffer.append(line, text - line);
+        }
+    }
+    else
+    {
+        buffer.append(text, size);
+    }
+
+    if (buffer.size() >= BufferSize)
+        flush();
+  }
+
+void
+ReportWriter::flush()
+  {
+    if (buffer.empty() == false && fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size())
+        failed = true;
+    buffer.clear();
+  }
+
+bool
+ReportWriter::close()
+  {
+    if (file == NULL)
+        return true;
+
+    if (report_format == SarifReport)
+        buffer += "]}]}\n";
+
+    flush();
+    if (fflush(file) != 0 || (file != stdout && fclose(file) != 0))
+        failed = true;
+    file = NULL;
+
+    return failed == false;
+  }
+
+/**
+ * Append text to out as a JSON string.
+ */
+void
+appendJson(string& out, const char* text)
+  {
+    out += '"';
+    for (const unsigned char* c = (const unsigned char*) text; *c != 0; ++c)
+    {
+        if (*c == '"' || *c == '\\')
+        {
+            out += '\\';
+            out += *c;
+        }
+        else if (*c < 0x20)
+        {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", *c);
+            out += escape;
+        }
+        else
+        {
+            out += *c;
+        }
+    }
+    out += '"';
+  }
+
+/**
+ * \return the URI of the file fileName: a file:// URI if the path is
+ * absolute, a relative reference otherwise, with every byte of the path
+ * but the unreserved characters and the slashes percent-encoded.
+ */
+string
+fileUri(const char* fileName)
+  {
+    string uri = fileName[0] == '/' ? "file://" : "";
+    for (const unsigned char* c = (const unsigned char*) fileName; *c != 0; ++c)
+    {
+        if (isalnum(*c) || *c == '/' || *c == '-' || *c == '.' || *c == '_' || *c == '~')
+        {
+            uri += *c;
+        }
+        else
+        {
+            char escape[4];
+            snprintf(escape, sizeof(escape), "%%%02X", *c);
+            uri += escape;
+        }
+    }
+
+    return uri;
+  }
+
+/**
+ * Append the SARIF location of the declaration to out.
+ */
+void
+appendSarifLocation(string& out, const Declaration& declaration)
+  {
+    out += "{\"physicalLocation\":{\"artifactLocation\":{\"uri\":";
+    appendJson(out, fileUri(declaration.file).c_str());
+    out += '}';
+
+    // Compiler generated declarations have no line.
+    if (declaration.line > 0)
+    {
+        char region[48];
+        snprintf(region, sizeof(region), ",\"region\":{\"startLine\":%u}", declaration.line);
+        out += region;
+    }
+    out += "}}";
+  }
+
+/**
+ * The candidate pairs of the names of a large scope, by locality-sensitive
+ * hashing.  Each name is a set of character bigrams (the ends of the name
+ * counting as a character, so every name has some), whose MinHash signature
+ * is cut into lsh_bands bands of lsh_rows values; two names are a candidate
+ * pair if any band of theirs is the same.  Names whose sets of bigrams have
+ * a Jaccard similarity of s are paired with probability
+ * 1 - (1 - s^lsh_rows)^lsh_bands: more bands find more of the matches, more
+ * rows find fewer pairs that are not.  The candidate pairs are then scored as
+ * usual, so the report holds a subset of the exact matches.
+ */
+class LshIndex
+  {
+    public:
+      /// Scopes of up to this many distinct names are always scored exactly.
+      static const size_t MinCandidates = 1024;
+
+      LshIndex() : isActive(false) {}
+
+      /**
+       * Find the candidate pairs (k, j) of candidates, keeping those with j
+       * in (k, windowEnd[k]).
+       */
+      void build(const CandidateBlock& candidates, const vector<uint32_t>& windowEnd);
+
+      /**
+       * Go back to scoring every pair.
+       */
+      void clear();
+
+      bool active() const { return isActive; }
+
+      /**
+       * The candidates paired with candidate k are [begin(k), end(k)), in
+       * ascending order.
+       */
+      const uint32_t* begin(size_t k) const { return partners.empty() ? NULL : &partners[0] + partnerStart[k]; }
+      const uint32_t* end(size_t k) const { return partners.empty() ? NULL : &partners[0] + partnerStart[k + 1]; }
+
+    private:
+      bool             isActive;
+      vector<uint32_t> partnerStart;
+      vector<uint32_t> partners;
+  };
+
+const size_t LshIndex::MinCandidates;
+
+void
+LshIndex::build(const CandidateBlock& candidates, const vector<uint32_t>& windowEnd)
+  {
+    size_t count  = candidates.size();
+    size_t hashes = (size_t) lsh_bands * lsh_rows;
+
+    // The bigrams of each name, with 256 marking the ends, each hashed once
+    // and then again by every hash function of the signature.
+    vector<uint64_t> signatures(count * hashes, ~(uint64_t) 0);
+    for (size_t k = 0; k < count; ++k)
+    {
+        const unsigned char* name = (const unsigned char*) candidates.name(k);
+        size_t length = candidates.length(k);
+        uint64_t* signature = &signatures[k * hashes];
+
+        unsigned previous = 256;
+        for (size_t p = 0; p <= length; ++p)
+        {
+            unsigned next = (p < length) ? name[p] : 256;
+            uint64_t bigram = mixBits(((uint64_t) previous << 9) | next);
+
+            for (size_t h = 0; h < hashes; ++h)
+                signature[h] = min(signature[h], mixBits(bigram + (h + 1) * 0x9e3779b97f4a7c15ull));
+
+            previous = next;
+        }
+    }
+
+    // The names of each bucket of a band are in ascending order, as are
+    // the ends of their length windows.
+    vector< pair<uint64_t, uint32_t> > buckets(count);
+    vector<uint64_t> pairs;
+    for (unsigned b = 0; b < lsh_bands; ++b)
+    {
+        for (size_t k = 0; k < count; ++k)
+        {
+            uint64_t band = hashBytes(&signatures[k * hashes + b * lsh_rows], lsh_rows * sizeof(uint64_t));
+            buckets[k] = pair<uint64_t, uint32_t> (band, (uint32_t) k);
+        }
+        sort(buckets.begin(), buckets.end());
+
+        size_t last;
+        for (size_t first = 0; first < count; first = last)
+        {
+            for (last = first + 1; last < count && buckets[last].first == buckets[first].first; ++last)
+                ;
+
+            for (size_t a = first; a < last; ++a)
+            {
+                uint32_t k = buckets[a].second;
+                for (size_t c = a + 1; c < last && buckets[c].second < windowEnd[k]; ++c)
+                    pairs.push_back(((uint64_t) k << 32) | buckets[c].second);
+            }
+        }
+    }
+
+    sort(pairs.begin(), pairs.end());
+    pairs.erase(unique(pairs.begin(), pairs.end()), pairs.end());
+
+    partnerStart.assign(count + 1, 0);
+    partners.resize(pairs.size());
+    for (size_t p = 0; p < pairs.size(); ++p)
+    {
+        ++partnerStart[(pairs[p] >> 32) + 1];
+        partners[p] = (uint32_t) pairs[p];
+    }
+    for (size_t k = 0; k < count; ++k)
+        partnerStart[k + 1] += partnerStart[k];
+
+    isActive = true;
+  }
+
+void
+LshIndex::clear()
+  {
+    isActive = false;
+    partnerStart.clear();
+    partners.clear();
+  }
+
+/**
+ * How the pairs of distinct strings of a scope were dealt with: each pair
+ * is either outside the length windows, pruned by a prefilter, found in
+ * the ScoreMemo or scored by a kernel.
+ */
+class ScoringCounters
+  {
+    public:
+      ScoringCounters()
+        : pairs(0), prunedByLength(0), prunedByGroup(0), prunedByKind(0), canonical(0),
+          prunedByHistogram(0), prunedByLsh(0), memoized(0), scored(0), matches(0), reported(0)
+        {}
+
+      void add(const ScoringCounters& other);
+
+      uint64_t pairs;             ///< Pairs of distinct (non-empty) strings
+      uint64_t prunedByLength;    ///< Outside the length windows
+      uint64_t prunedByGroup;     ///< Already compared in a nested scope
+      uint64_t prunedByKind;      ///< Kinds of names the ComparisonRules don't compare
+      uint64_t canonical;         ///< Matching by their canonicalName()s, unscored
+      uint64_t prunedByHistogram; ///< Too few characters in common
+      uint64_t prunedByLsh;       ///< Not a candidate pair of the LshIndex
+      uint64_t memoized;          ///< Scores found in the ScoreMemo
+      uint64_t scored;            ///< Kernel invocations, one per pair
+      uint64_t matches;           ///< Matching pairs of strings
+      uint64_t reported;          ///< Matching pairs of names
+  };
+
+void
+ScoringCounters::add(const ScoringCounters& other)
+  {
+    pairs             += other.pairs;
+    prunedByLength    += other.prunedByLength;
+    prunedByGroup     += other.prunedByGroup;
+    prunedByKind      += other.prunedByKind;
+    canonical         += other.canonical;
+    prunedByHistogram += other.prunedByHistogram;
+    prunedByLsh       += other.prunedByLsh;
+    memoized          += other.memoized;
+    scored            += other.scored;
+    matches           += other.matches;
+    reported          += other.reported;
+  }
+
+/**
+ * The cost of one scope (see stats_mode).
+ */
+class ScopeStatistics
+  {
+    public:
+      Declaration     scope;
+      uint32_t        names;
+      ScoringCounters counters;
+      double          seconds;
+  };
+
+/**
+ * Where the time of a run goes, and what the scoring did, in total and
+ * (in stats_mode) by scope.  Each Traversal keeps its own, the scorer of
+ * the pipeline's being added to the extractor's at the end.
+ */
+class RunStatistics
+  {
+    public:
+      enum Phase { FrontendPhase, TraversalPhase, ScoringPhase, OutputPhase, NumberOfPhases };
+
+      RunStatistics();
+
+      void add(const RunStatistics& other);
+
+      /**
+       * Print the summary, and the scopes that took the longest to score.
+       */
+      void print(FILE* file, uint64_t names) const;
+
+      /**
+       * Write a JSON object per scope, then one of the totals, to fileName.
+       */
+      bool write(const string& fileName, uint64_t names) const;
+
+      /**
+       * Count the matches into the thresholdMatches.
+       */
+      void countThresholds(const vector<NameMatch>& matches);
+
+      /**
+       * Print the number of matches more than each of the threshold_bins.
+       */
+      void printThresholds(FILE* file) const;
+
+      double                  seconds[NumberOfPhases];
+      uint64_t                scopes;
+      ScoringCounters         totals;
+      vector<ScopeStatistics> scopeStatistics;
+      vector<uint64_t>        thresholdMatches;   ///< By threshold_bins
+
+    private:
+      static void appendCounters(string& line, const ScoringCounters& counters);
+
+      static bool longerScope(const ScopeStatistics& a, const ScopeStatistics& b)
+        {
+          return a.seconds > b.seconds;
+        }
+  };
+
+RunStatistics::RunStatistics()
+  : scopes(0)
+  {
+    for (int phase = 0; phase < NumberOfPhases; ++phase)
+        seconds[phase] = 0;
+  }
+
+void
+RunStatistics::add(const RunStatistics& other)
+  {
+    for (int phase = 0; phase < NumberOfPhases; ++phase)
+        seconds[phase] += other.seconds[phase];
+
+    scopes += other.scopes;
+    totals.add(other.totals);
+
+    thresholdMatches.resize(max(thresholdMatches.size(), other.thresholdMatches.size()), 0);
+    for (size_t b = 0; b < other.thresholdMatches.size(); ++b)
+        thresholdMatches[b] += other.thresholdMatches[b];
+    scopeStatistics.insert(scopeStatistics.end(), other.scopeStatistics.begin(), other.scopeStatistics.end());
+  }
+
+void
+RunStatistics::countThresholds(const vector<NameMatch>& matches)
+  {
+    thresholdMatches.resize(threshold_bins.size(), 0);
+
+    // The bins are ascending: a match is more than the first few.
+    for (size_t m = 0; m < matches.size(); ++m)
+    {
+        for (size_t b = 0; b < threshold_bins.size() && matches[m].similarity > threshold_bins[b]; ++b)
+            ++thresholdMatches[b];
+    }
+  }
+
+void
+RunStatistics::printThresholds(FILE* file) const
+  {
+    fprintf(file, "\nMatching names by threshold:\n");
+    for (size_t b = 0; b < threshold_bins.size(); ++b)
+    {
+        uint64_t matches = b < thresholdMatches.size() ? thresholdMatches[b] : 0;
+        fprintf(file, "  more than %-12.3f %12lu\n", threshold_bins[b], (unsigned long) matches);
+    }
+  }
+
+void
+RunStatistics::print(FILE* file, uint64_t names) const
+  {
+    static const char* phases[] = { "frontend", "traversal", "scoring", "output" };
+
+    fprintf(file, "\nStatistics:\n");
+    for (int phase = 0; phase < NumberOfPhases; ++phase)
+        fprintf(file, "  %-22s %12.3f s\n", phases[phase], seconds[phase]);
+
+    double pairs = (totals.pairs > 0) ? (double) totals.pairs : 1;
+    fprintf(file, "  %-22s %12lu\n", "names", (unsigned long) names);
+    fprintf(file, "  %-22s %12lu\n", "scopes", (unsigned long) scopes);
+    fprintf(file, "  %-22s %12lu\n", "pairs of strings", (unsigned long) totals.pairs);
+
+    const char*    labels[] = { "pruned by length", "pruned by group", "pruned by kind",
+                                "canonical", "pruned by histogram", "pruned by LSH", "memoized",
+                                "scored" };
+    const uint64_t counts[] = { totals.prunedByLength, totals.prunedByGroup, totals.prunedByKind,
+                                totals.canonical, totals.prunedByHistogram, totals.prunedByLsh,
+                                totals.memoized, totals.scored };
+    for (size_t k = 0; k < sizeof(counts) / sizeof(counts[0]); ++k)
+        fprintf(file, "    %-20s %12lu %6.2f%%\n", labels[k], (unsigned long) counts[k], 100 * counts[k] / pairs);
+
+    fprintf(file, "  %-22s %12lu\n", "matching strings", (unsigned long) totals.matches);
+    fprintf(file, "  %-22s %12lu\n", "matching names", (unsigned long) totals.reported);
+
+    if (threshold_bins.empty() == false)
+        printThresholds(file);
+
+    if (scopeStatistics.empty())
+        return;
+
+    vector<ScopeStatistics> longest(scopeStatistics);
+    size_t shown = min((size_t) 10, longest.size());
+    partial_sort(longest.begin(), longest.begin() + shown, longest.end(), longerScope);
+
+    fprintf(file, "\n  %10s %8s %12s %12s %8s  %s\n", "seconds", "names", "pairs", "scored", "matches", "scope");
+    for (size_t k = 0; k < shown; ++k)
+    {
+        const ScopeStatistics& s = longest[k];
+        fprintf(file, "  %10.6f %8u %12lu %12lu %8lu  %s %s (%s:%u)\n",
+                s.seconds, s.names, (unsigned long) s.counters.pairs,
+                (unsigned long) s.counters.scored, (unsigned long) s.counters.reported,
+                s.scope.kind, s.scope.name, s.scope.file, s.scope.line);
+    }
+  }
+
+void
+RunStatistics::appendCounters(string& line, const ScoringCounters& counters)
+  {
+    char text[512];
+    snprintf(text, sizeof(text),
+             "\"pairs\":%lu,\"prunedByLength\":%lu,\"prunedByGroup\":%lu,\"prunedByKind\":%lu,"
+             "\"canonical\":%lu,\"prunedByHistogram\":%lu,\"prunedByLsh\":%lu,\"memoized\":%lu,"
+             "\"scored\":%lu,\"matches\":%lu,\"reported\":%lu",
+             (unsigned long) counters.pairs, (unsigned long) counters.prunedByLength,
+             (unsigned long) counters.prunedByGroup, (unsigned long) counters.prunedByKind,
+             (unsigned long) counters.canonical, (unsigned long) counters.prunedByHistogram,
+             (unsigned long) counters.prunedByLsh, (unsigned long) counters.memoized,
+             (unsigned long) counters.scored, (unsigned long) counters.matches,
+             (unsigned long) counters.reported);
+    line += text;
+  }
+
+bool
+RunStatistics::write(const string& fileName, uint64_t names) const
+  {
+    FILE* file = fopen(fileName.c_str(), "w");
+    if (file == NULL)
+        return false;
+
+    string line;
+    for (size_t k = 0; k < scopeStatistics.size(); ++k)
+    {
+        const ScopeStatistics& s = scopeStatistics[k];
+
+        line = "{\"kind\":";
+        appendJson(line, s.scope.kind);
+        line += ",\"name\":";
+        appendJson(line, s.scope.name);
+        line += ",\"file\":";
+        appendJson(line, s.scope.file);
+
+        char text[96];
+        snprintf(text, sizeof(text), ",\"line\":%u,\"names\":%u,\"seconds\":%.6f,", s.scope.line, s.names, s.seconds);
+        line += text;
+
+        appendCounters(line, s.counters);
+        line += "}\n";
+        fputs(line.c_str(), file);
+    }
+
+    char text[256];
+    snprintf(text, sizeof(text),
+             "{\"total\":true,\"frontend\":%.6f,\"traversal\":%.6f,\"scoring\":%.6f,\"output\":%.6f,"
+             "\"names\":%lu,\"scopes\":%lu,",
+             seconds[FrontendPhase], seconds[TraversalPhase], seconds[ScoringPhase], seconds[OutputPhase],
+             (unsigned long) names, (unsigned long) scopes);
+    line = text;
+    appendCounters(line, totals);
+
+    if (threshold_bins.empty() == false)
+    {
+        line += ",\"thresholds\":[";
+        for (size_t b = 0; b < threshold_bins.size(); ++b)
+        {
+            snprintf(text, sizeof(text), "%s{\"threshold\":%.3f,\"matches\":%lu}", b > 0 ? "," : "",
+                     threshold_bins[b], (unsigned long) (b < thresholdMatches.size() ? thresholdMatches[b] : 0));
+            line += text;
+        }
+        line += ']';
+    }
+
+    line += "}\n";
+    fputs(line.c_str(), file);
+
+    return fclose(file) == 0;
+  }
+
+/**
+ * The scopes of the names extracted so far, flattened for the scoring (see
+ * Traversal::scoreScopes()): once finish()ed, the scopes in pre-order,
+ * each with the index of its parent and the range of its names (which
+ * includes those of the scopes inside it).  The scoring needs neither the
+ * AST nor any recursion then.
+ */
+class ScopeTree
+  {
+    public:
+      static const uint32_t NoParent = ~(uint32_t) 0;
+
+      class Scope
+        {
+          public:
+            Declaration declaration;
+            NameId      begin;          ///< Its names are [begin, end)
+            NameId      end;
+            uint32_t    parent;         ///< The scope enclosing it, or NoParent
+            uint32_t    order;          ///< Its number in the order the scopes ended
+            string*     reportBuffer;   ///< Where its report goes (see Traversal::reportBuffer)
+        };
+
+      /**
+       *  Add a scope that ended (after the scopes inside it).
+       */
+      void add(const Declaration& declaration, NameId begin, NameId end, string* reportBuffer);
+
+      /**
+       *  Sort the scopes into pre-order, and link them to their parents.
+       */
+      void finish();
+
+      size_t size() const { return scopes.size(); }
+      bool empty() const { return scopes.empty(); }
+      void clear() { scopes.clear(); }
+
+      Scope& operator[](size_t k) { return scopes[k]; }
+      const Scope& operator[](size_t k) const { return scopes[k]; }
+
+    private:
+      static bool precedes(const Scope& a, const Scope& b);
+
+      vector<Scope> scopes;
+  };
+
+const uint32_t ScopeTree::NoParent;
+
+void
+ScopeTree::add(const Declaration& declaration, NameId begin, NameId end, string* reportBuffer)
+  {
+    Scope scope;
+    scope.declaration  = declaration;
+    scope.begin        = begin;
+    scope.end          = end;
+    scope.parent       = NoParent;
+    scope.order        = (uint32_t) scopes.size();
+    scope.reportBuffer = reportBuffer;
+    scopes.push_back(scope);
+  }
+
+bool
+ScopeTree::precedes(const Scope& a, const Scope& b)
+  {
+    // The ranges of two scopes are disjoint or nested, and a scope with the
+    // same names as one inside it ended after it.
+    if (a.begin != b.begin)
+        return a.begin < b.begin;
+    if (a.end != b.end)
+        return a.end > b.end;
+    return a.order > b.order;
+  }
+
+void
+ScopeTree::finish()
+  {
+    sort(scopes.begin(), scopes.end(), precedes);
+
+    // The scopes enclosing the current one, innermost last.
+    vector<uint32_t> enclosing;
+    for (size_t k = 0; k < scopes.size(); ++k)
+    {
+        while (enclosing.empty() == false && scopes[enclosing.back()].end <= scopes[k].begin)
+            enclosing.pop_back();
+
+        scopes[k].parent = enclosing.empty() ? NoParent : enclosing.back();
+        enclosing.push_back((uint32_t) k);
+    }
+  }
+
+class PairTile;
+
+/**
+ * Group of names occurring in more than one group (see ScopeScorer::candidateGroups).
+ */
+const NameId MultipleGroups = ~(NameId) 0;
+
+/**
+ * Canonical name of the strings whose canonicalName() was not computed yet
+ * (see ScopeScorer::canonicalOf()).
+ */
+const NameId UnknownCanonical = NameTable::NoString - 1;
+
+/**
+ * The scoring of the names of a scope, with the workspace it reuses from
+ * one scope to the next.  Different scorers may score scopes with disjoint
+ * ranges of names concurrently (see Traversal::scoreScopes()): they only
+ * read the NameTable and the ScoreMemo, keeping the scores they compute in
+ * newScores until flushScores() adds them to the memo.
+ */
+class ScopeScorer
+  {
+    public:
+      ScopeScorer(NameTable& nameTable, ScoreMemo& scoreMemo, WorkStealingPool* pool)
+        : nameTable(nameTable),
+          scoreMemo(scoreMemo),
+          pool(pool),
+          incremental(incremental_mode),
+          spill(NULL),
+          spillMatches(0)
+        {}
+
+      /**
+       *  Apply the similarity metric to the pairs of names [begin, end),
+       *  adding the matches to results.  With partners (of the kinds of
+       *  names, see ComparisonRules::partners()) only the pairs of kinds
+       *  they allow are compared, otherwise all of them.  With runs, the
+       *  results spill to them (see spillResults()), only those still in
+       *  memory being sorted.
+       */
+      void scoreNames(NameId begin, NameId end, vector<NameMatch>& results,
+                      const uint32_t* partners = NULL, vector<MatchSpill::Run>* runs = NULL);
+
+      /**
+       *  Write the results to a run of the spill once there are spillMatches
+       *  of them (and runs to add it to), \return how many were written.
+       */
+      size_t spillResults(vector<NameMatch>& results, vector<MatchSpill::Run>* runs);
+
+      /**
+       *  Add the pairs of the occurrences of the two strings of a match
+       *  (by their first occurrences in the scope) to results, but those
+       *  of the same group or of kinds the partners don't compare.
+       */
+      void addOccurrences(const NameMatch& match, vector<NameMatch>& results,
+                          const uint32_t* partners);
+
+      /**
+       *  \return the stringId of the canonicalName() of the name's string in
+       *  canonicalNames, NameTable::NoString if it is empty.
+       */
+      NameId canonicalOf(const NameStructureType& name);
+
+      /**
+       *  Apply the similarity metric to the pairs of names in a tile
+       *  (safe to call concurrently for different tiles).
+       */
+      void scoreTile(PairTile& tile);
+
+      /**
+       *  \return false if candidates ii and k (of length len1) can be
+       *  rejected without scoring them, counting why in counters.
+       */
+      bool mayMatch(size_t ii, size_t k, size_t len2, size_t len1, ScoringCounters& counters) const
+        {
+          // Strings that only occur within the same group were already
+          // compared in a nested scope.
+          NameId group = candidateGroups[ii];
+          if (group == candidateGroups[k] && group != MultipleGroups)
+            {
+              ++counters.prunedByGroup;
+              return false;
+            }
+
+          // And those where no kinds of the names are compared.
+          if ((candidatePartners[ii] & candidateKinds[k]) == 0)
+            {
+              ++counters.prunedByKind;
+              return false;
+            }
+
+          // Trivial variants match without scoring (see canonical_mode).
+          NameId canonical = candidateCanonicals[ii];
+          if (canonical == candidateCanonicals[k] && canonical != NameTable::NoString)
+            {
+              ++counters.canonical;
+              return false;
+            }
+
+          // Reject those where even the number of characters the two
+          // names have in common can't exceed the threshold.
+          if (len1 <= NameSignature::MaxLength)
+            {
+              size_t common = candidateSignatures[ii].commonCharacters(candidateSignatures[k]);
+              if (pruningBounds.commonMayMatch(common, len2, len1) == false)
+                {
+                  ++counters.prunedByHistogram;
+                  return false;
+                }
+            }
+
+          return true;
+        }
+
+      /**
+       *  Add the newScores to the ScoreMemo (while no scorer is scoring).
+       */
+      void flushScores();
+
+      NameTable& nameTable;
+      ScoreMemo& scoreMemo;
+
+      /**
+       *  Threads for scoring the tiles of large scopes (NULL when serial).
+       */
+      WorkStealingPool* pool;
+
+      /**
+       *  Whether the pairs of names of the same group are left out (as in
+       *  incremental_mode, which it is by default).
+       */
+      bool incremental;
+
+      /**
+       *  Similarities computed since the last flushScores(), by pair of strings.
+       */
+      vector< pair<uint64_t,float> > newScores;
+
+      /**
+       *  Where the matches of a scope spill once there are spillMatches of
+       *  them (see memory_budget), NULL if they don't.
+       */
+      MatchSpill* spill;
+      size_t      spillMatches;
+
+      /**
+       *  The names of the scope being processed, packed for batched scoring.
+       */
+      CandidateBlock candidates;
+
+      /**
+       *  The distinct strings of the scope being scored (see scoreNames()).
+       *  uniqueOfString maps stringIds to their number in the scope, and is
+       *  MultipleGroups for the strings not in it.
+       */
+      vector<NameId> uniqueOfString;
+      vector<NameId> uniqueStrings;
+      vector<NameId> uniqueGroups;
+      vector<uint32_t> uniqueKinds;
+      vector<NameId> uniqueOccurrenceStart;
+      vector<NameId> uniqueOccurrences;
+
+      /**
+       *  The distinct strings of the scope, sorted by length, each candidate
+       *  being represented by the id of its first occurrence.  For each
+       *  candidate k, only the candidates in [k + 1, candidateWindowEnd[k])
+       *  are close enough in length to be similar to it.
+       */
+      vector<NameId>   candidateIds;
+      vector<uint32_t> candidateWindowEnd;
+
+      /**
+       *  The group of all the occurrences of each candidate, or
+       *  MultipleGroups if they are not all in the same one.
+       */
+      vector<NameId>   candidateGroups;
+
+      /**
+       *  The kinds (1 << NameKind) of the occurrences of each candidate, and
+       *  the kinds they are compared with in the scope.
+       */
+      vector<uint32_t> candidateKinds;
+      vector<uint32_t> candidatePartners;
+
+      /**
+       *  The canonicalOf() each candidate in canonical_mode, NameTable::NoString
+       *  otherwise; and the last candidate of the scope so far with each
+       *  canonical name (~0 for none), each being chained to the previous
+       *  one in candidateCanonicalPrevious.
+       */
+      vector<NameId>   candidateCanonicals;
+      vector<uint32_t> lastOfCanonical;
+      vector<uint32_t> candidateCanonicalPrevious;
+
+      /**
+       *  The canonicalName()s of the strings, by their stringId (or
+       *  UnknownCanonical).
+       */
+      NameTable      canonicalNames;
+      vector<NameId> canonicalOfString;
+
+      /**
+       *  The NameSignature of each candidate.
+       */
+      vector<NameSignature> candidateSignatures;
+
+      /**
+       *  The candidate pairs to score, if the scope is too large to score
+       *  all of them (see lsh_bands).
+       */
+      LshIndex lshIndex;
+
+      /**
+       *  The counters of the last scope scored.
+       */
+      ScoringCounters scopeCounters;
+  };
+
+/**
+ * TODO:
+ */
+class Traversal :
+  public SgTopDownBottomUpProcessing<InheritedAttribute, SynthesizedAttribute>
+  {
+    public:
+      /**
+       *  With more than one thread, the scoring (or the extraction of the
+       *  files) is spread over a pool of them.
+       */
+      Traversal(unsigned numberOfThreads = number_of_threads);
+      ~Traversal();
+
+      //== Functions required to support the AST traversal:
+
+      InheritedAttribute
+      evaluateInheritedAttribute(
+          SgNode* astNode,
+          InheritedAttribute inheritedAttribute);
+
+      SynthesizedAttribute
+      evaluateSynthesizedAttribute(
+          SgNode* astNode,
+          InheritedAttribute inheritedAttribute,
+          SubTreeSynthesizedAttributes synthesizedAttributeList );
+
+      //== Extraction of the names from the AST:
+
+      /**
+       *  Bookkeeping of the input files, on the way down and up the AST.
+       */
+      void enterNode(SgNode* n);
+      void leaveNode(SgNode* n, SynthesizedAttribute& synthesizedAttribute);
+
+      /**
+       *  Extract the names below n as the traversal does, but without
+       *  visiting expressions (see fast_extraction).
+       */
+      void extract(SgNode* n);
+
+      /**
+       *  Extract and score the names of each file of the project on a
+       *  (serial) Traversal of its own, the files side by side on the pool,
+       *  then report them in order (see extractNames()).
+       */
+      void extractFiles(SgProject* project);
+
+      /**
+       *  \return the number of names extracted, by this traversal and those
+       *  of the fileTraversals.
+       */
+      size_t numberOfNames() const;
+
+      /**
+       *  Extract the name and add it to the list/set.
+       */
+      void processNode (SgNode* n, SynthesizedAttribute& synthesizedAttribute);
+
+      /**
+       *  Add the name declared at n to the name table (unless excluded, or
+       *  of a kind the comparisonRules never compare).
+       */
+      void addName(const string& name, SgNode* n);
+
+      /**
+       *  \return what the reports say about the declaration at n (its name
+       *  being NULL if it is the given name).
+       */
+      Declaration declarationOf(SgNode* n, const string* name = NULL);
+
+      /**
+       *  \return true if the names declared at n are left out of the
+       *  comparison (see exclude_system_headers).
+       */
+      bool isExcluded(SgNode* n);
+
+      //== Scoring, from the AST or from a NameStream:
+
+      /**
+       *  Add a name to the name table.
+       */
+      void addName(const string& name, const Declaration& declaration, NameKind kind = LocalName);
+
+      /**
+       *  The scope of the names [begin, nameTable.size()) ended: add it to
+       *  the scopeTree (or the nameStream).
+       */
+      void endScope(const Declaration& scope, NameId begin);
+
+      /**
+       *  Score the names of the NameStream in fileName, as the scoreScopes()
+       *  after its extraction would have.  \return false if it's not valid.
+       */
+      bool replayNames(const string& fileName, bool scopes = true);
+      bool replayNames(const char* events, const char* end, bool scopes = true);
+
+      /**
+       *  Compute the key for the matches of a scope located in a header,
+       *  \return false if the scope is not in a header (see cache_headers).
+       */
+      bool headerScopeKey(const Declaration& scope, NameId begin, NameId end, uint64_t& key);
+
+      /**
+       *  Score the names of all the scopes of the scopeTree, from the
+       *  innermost out, then report them in the order they ended; and
+       *  clear the scopeTree.
+       */
+      void scoreScopes();
+
+      /**
+       *  Match the names of the scope for similarity with scorer, its cost
+       *  going to cost and the matches that spill to runs; then regroup
+       *  them (see incremental_mode).  Safe to call concurrently, with
+       *  different scorers, for scopes of disjoint ranges of names.
+       */
+      void scoreScope(ScopeScorer& scorer, const ScopeTree::Scope& scope,
+                      vector<NameMatch>& results, vector<MatchSpill::Run>& runs,
+                      ScopeStatistics& cost);
+
+      /**
+       *  Hold no more matches while scoring (and no more scores in the
+       *  ScoreMemo, nor matches in the header cache) than fit in bytes,
+       *  none if 0 (see memory_budget).
+       */
+      void budgetMemory(size_t bytes);
+
+      /**
+       *  The scorers of the ScopeTasks, which acquire one for their scopes
+       *  and release it when done.
+       */
+      ScopeScorer* acquireScorer();
+      void releaseScorer(ScopeScorer* scorer);
+
+      /**
+       *  Report the matches of the names of a scope, those in runs of the
+       *  matchSpill merged with the results, and count them in the
+       *  statistics.
+       */
+      void reportScope(const Declaration& scope, vector<NameMatch>& results,
+                       const vector<MatchSpill::Run>& runs);
+
+      /**
+       *  Report the matches (in name table order) of the names of a scope,
+       *  or only the first part (opening the report of the scope) or the
+       *  next ones (closing it with the last) of them.
+       */
+      void reportMatches(const Declaration& scope, vector<NameMatch>& results,
+                         bool opens = true, bool closes = true);
+
+      /**
+       *  printf() to the reportBuffer, or straight to the output if NULL.
+       */
+      void report(const char* format, ...);
+
+      /**
+       *  Append text to the reportBuffer, or write it to the output if NULL.
+       */
+      void reportText(const string& text);
+
+      /**
+       *  Append one match of the scope to text in the report_format (as a
+       *  line, unless it is the TextReport).
+       */
+      void formatMatch(string& text, const Declaration& scope, const NameMatch& match,
+                       const string& lcs) const;
+
+      /**
+       *  Where the reports go (that of the input file being indexed, say).
+       */
+      string* reportBuffer;
+
+      /**
+       *  All the names collected from the project.
+       */
+      NameTable nameTable;
+
+      /**
+       *  The scopes of the names collected, until they are scored.
+       */
+      ScopeTree scopeTree;
+
+      /**
+       *  The cost of the run so far.
+       */
+      RunStatistics statistics;
+
+      /**
+       *  Similarities computed so far, by pair of strings.
+       */
+      ScoreMemo scoreMemo;
+
+      /**
+       *  Threads for scoring the small scopes side by side, and the tiles of
+       *  the large ones (NULL when serial).
+       */
+      WorkStealingPool* pool;
+
+      /**
+       *  Scores the scopes one at a time (with the pool for their tiles).
+       */
+      ScopeScorer scopeScorer;
+
+      /**
+       *  Where the matches of the scopes go between their scoring and their
+       *  report beyond the matchBudget (none if 0) of matches held.
+       */
+      MatchSpill matchSpill;
+      size_t     matchBudget;
+
+      /**
+       *  The file names of the project's input files; anything else is a header.
+       */
+      set<string> inputFiles;
+
+      /**
+       *  The input files being indexed, by file name (see SimilarityIndex).
+       */
+      map<string, IndexRecord*> indexRecords;
+
+      /**
+       *  Where the names are written instead of being scored (if not NULL).
+       */
+      NameStream* nameStream;
+
+      /**
+       *  The traversals of the files extracted by extractFiles(), which keep
+       *  their names (for the index).
+       */
+      vector<Traversal*> fileTraversals;
+
+    private:
+      /// The record of the input file being traversed, and its last dependency.
+      IndexRecord* currentRecord;
+      string       lastDependency;
+
+      /// The input file being extracted (see extract()).
+      string       currentInputFile;
+
+      /// The file of the last name checked by isExcluded(), and the verdict.
+      string lastFileName;
+      bool   lastFileExcluded;
+
+      /// The function declaration of the last parameter list left, and its
+      /// names: those of the function definition that follows it in the
+      /// declaration are the first of its scope (see enterNode()).
+      SgNode* lastParameterList;
+      NameId  parametersBegin;
+      NameId  parametersEnd;
+
+      /// Where the scopes of the function definitions being traversed begin.
+      vector<NameId> functionScopeBegins;
+
+      /// The traversal whose header cache this one uses: itself, or the one
+      /// whose files it extracts (see extractFiles()).
+      Traversal* headerCache;
+
+      /// Hashes of the contents of the headers seen so far.
+      map<string, uint64_t> headerHashes;
+
+      /// The matches of scopes in headers, with name ids relative to the scope.
+      map<uint64_t, vector<NameMatch> > headerScopeMatches;
+
+      /// How many matches headerScopeMatches holds, and may hold (if not 0).
+      size_t headerMatches;
+      size_t headerBudget;
+
+      /// Serializes the scopes using headerHashes and headerScopeMatches
+      /// (of all the traversals sharing them).
+      pthread_mutex_t headerLock;
+
+      /// All the scorers of the ScopeTasks, and those not in use.
+      vector<ScopeScorer*> taskScorers;
+      vector<ScopeScorer*> idleScorers;
+      pthread_mutex_t      scorersLock;
+  };
+
+/**
+ * A rectangle of the lower triangular part of the pairs of names of a scope:
+ * the pairs of candidates (i, j) with i in [iBegin, iEnd), j in [jBegin, jEnd)
+ * and i < j (see ScopeScorer::candidateIds).
+ */
+class PairTile : public PoolTask
+  {
+    public:
+      static const size_t Size = 256;  ///< Names along each side of a tile
+      static const size_t Wave = 1024; ///< Tiles scored at a time (see ScopeScorer::scoreNames())
+
+      PairTile(ScopeScorer* scorer,
+               size_t iBegin, size_t iEnd, size_t jBegin, size_t jEnd)
+        : scorer(scorer),
+          iBegin(iBegin), iEnd(iEnd),
+          jBegin(jBegin), jEnd(jEnd)
+        {}
+
+      void run() { scorer->scoreTile(*this); }
+
+      ScopeScorer* scorer;
+      size_t     iBegin, iEnd;
+      size_t     jBegin, jEnd;
+
+      /// The matching pairs of strings (by their first occurrences)
+      vector<NameMatch> results;
+
+      /// Scores computed by this tile, to be added to the ScoreMemo
+      vector< pair<uint64_t,float> > newScores;
+
+      /// What became of the pairs of this tile (but for the length windows)
+      ScoringCounters counters;
+  };
+
+const size_t PairTile::Size;
+const size_t PairTile::Wave;
+
+/**
+ * The scoring of some of the small scopes of a level of the ScopeTree,
+ * with a ScopeScorer of its own (see Traversal::scoreScopes()).
+ */
+class ScopeTask : public PoolTask
+  {
+    public:
+      static const size_t Names = 4096; ///< About as many names in each task
+
+      ScopeTask(Traversal* traversal, vector< vector<NameMatch> >* results,
+                vector< vector<MatchSpill::Run> >* runs, vector<ScopeStatistics>* costs)
+        : traversal(traversal),
+          results(results),
+          runs(runs),
+          costs(costs)
+        {}
+
+      void run();
+
+      Traversal* traversal;
+      vector<size_t> scopes;    ///< Of the ScopeTree
+      vector< vector<NameMatch> >*       results;
+      vector< vector<MatchSpill::Run> >* runs;
+      vector<ScopeStatistics>*           costs;
+  };
+
+const size_t ScopeTask::Names;
+
+void
+ScopeTask::run()
+  {
+    ScopeScorer* scorer = traversal->acquireScorer();
+
+    for (size_t k = 0; k < scopes.size(); ++k)
+    {
+        size_t scope = scopes[k];
+        traversal->scoreScope(*scorer, traversal->scopeTree[scope], (*results)[scope], (*runs)[scope],
+                              (*costs)[scope]);
+    }
+
+    traversal->releaseScorer(scorer);
+  }
+
+/**
+ * The extraction and scoring of the names of a file of the project, by a
+ * Traversal of its own (see Traversal::extractFiles()).
+ */
+class FileTask : public PoolTask
+  {
+    public:
+      FileTask(SgFile* file, Traversal* traversal)
+        : file(file),
+          traversal(traversal)
+        {}
+
+      void run();
+
+      SgFile*    file;
+      Traversal* traversal;
+      string     report;    ///< Unless the file is indexed (see Traversal::reportBuffer)
+  };
+
+void
+FileTask::run()
+  {
+    InheritedAttribute inheritedAttribute;
+    traversal->reportBuffer = &report;
+
+    // As extractNames() would for the project.
+    double start = secondsNow();
+    if (fast_extraction)
+        traversal->extract(file);
+    else if (input_files_only)
+        traversal->traverseWithinFile(file, inheritedAttribute);
+    else
+        traversal->traverse(file, inheritedAttribute);
+
+    traversal->statistics.seconds[RunStatistics::TraversalPhase] += secondsNow() - start;
+
+    traversal->scoreScopes();
+  }
+
+/**
+ * The longest common subsequences of a range of the matches of a scope
+ * (see show_lcs).
+ */
+class LcsTask : public PoolTask
+  {
+    public:
+      static const size_t Size = 64;  ///< Matches per task
+
+      LcsTask(const NameTable& nameTable, const vector<NameMatch>& results, vector<string>& lcs,
+              size_t begin, size_t end)
+        : nameTable(&nameTable),
+          results(&results),
+          lcs(&lcs),
+          begin(begin),
+          end(end)
+        {}
+
+      void run()
+        {
+          for (size_t k = begin; k != end; ++k)
+            {
+              const NameMatch& match = (*results)[k];
+              const NameStructureType& first  = (*nameTable)[match.first];
+              const NameStructureType& second = (*nameTable)[match.second];
+
+              longestCommonSubstring(first.c_str(), first.size(), second.c_str(), second.size(),
+                                     (*lcs)[k]);
+            }
+        }
+
+    private:
+      const NameTable*         nameTable;
+      const vector<NameMatch>* results;
+      vector<string>*          lcs;
+      size_t                   begin;
+      size_t                   end;
+  };
+
+const size_t LcsTask::Size;
+
+Traversal::Traversal(unsigned numberOfThreads)
+  : reportBuffer(NULL),
+    pool(numberOfThreads > 1 ? new WorkStealingPool(numberOfThreads) : NULL),
+    scopeScorer(nameTable, scoreMemo, pool),
+    matchBudget(0),
+    nameStream(NULL),
+    currentRecord(NULL),
+    lastFileExcluded(false),
+    lastParameterList(NULL),
+    parametersBegin(0),
+    parametersEnd(0),
+    headerCache(this),
+    headerMatches(0),
+    headerBudget(0)
+  {
+    pthread_mutex_init(&headerLock, NULL);
+    pthread_mutex_init(&scorersLock, NULL);
+
+    budgetMemory(memory_budget);
+  }
+
+Traversal::~Traversal()
+  {
+    for (size_t k = 0; k < fileTraversals.size(); ++k)
+        delete fileTraversals[k];
+
+    for (size_t k = 0; k < taskScorers.size(); ++k)
+        delete taskScorers[k];
+
+    pthread_mutex_destroy(&scorersLock);
+    pthread_mutex_destroy(&headerLock);
+    delete pool;
+  }
+
+void
+Traversal::budgetMemory(size_t bytes)
+  {
+    matchBudget  = bytes / 2 / sizeof(NameMatch);
+    headerBudget = bytes / 4 / sizeof(NameMatch);
+    scoreMemo.limit(bytes / 4);
+  }
+
+ScopeScorer*
+Traversal::acquireScorer()
+  {
+    pthread_mutex_lock(&scorersLock);
+    if (idleScorers.empty())
+    {
+        taskScorers.push_back(new ScopeScorer(nameTable, scoreMemo, NULL));
+        idleScorers.push_back(taskScorers.back());
+    }
+
+    ScopeScorer* scorer = idleScorers.back();
+    idleScorers.pop_back();
+    pthread_mutex_unlock(&scorersLock);
+
+    return scorer;
+  }
+
+void
+Traversal::releaseScorer(ScopeScorer* scorer)
+  {
+    pthread_mutex_lock(&scorersLock);
+    idleScorers.push_back(scorer);
+    pthread_mutex_unlock(&scorersLock);
+  }
+
+void
+Traversal::report(const char* format, ...)
+  {
+    va_list arguments;
+    va_start(arguments, format);
+
+    string  output;
+    string& text = (reportBuffer != NULL) ? *reportBuffer : output;
+    size_t length = text.size();
+
+    va_list copy;
+    va_copy(copy, arguments);
+
+    char buffer[512];
+    int size = vsnprintf(buffer, sizeof(buffer), format, arguments);
+    if (size >= (int) sizeof(buffer))
+    {
+        text.resize(length + size + 1);
+        vsnprintf(&text[length], size + 1, format, copy);
+        text.resize(length + size);
+    }
+    else if (size > 0)
+    {
+        text.append(buffer, size);
+    }
+
+    va_end(copy);
+    va_end(arguments);
+
+    if (reportBuffer == NULL)
+        reportWriter.write(output);
+  }
+
+void
+Traversal::reportText(const string& text)
+  {
+    if (reportBuffer == NULL)
+        reportWriter.write(text);
+    else
+        reportBuffer->append(text);
+  }
+
+bool
+Traversal::isExcluded(SgNode* n)
+  {
+    if (exclude_system_headers == false && excluded_paths.empty())
+        return false;
+
+    Sg_File_Info* fileInfo = n->get_file_info();
+    if (fileInfo == NULL || fileInfo->isCompilerGenerated())
+        return exclude_system_headers;
+
+    // Consecutive names mostly come from the same file.
+    const char* fileName = fileInfo->get_filename();
+    if (lastFileName != fileName)
+    {
+        lastFileName = fileName;
+        lastFileExcluded = exclude_system_headers && isSystemHeader(lastFileName);
+
+        for (size_t i = 0; i < excluded_paths.size() && lastFileExcluded == false; ++i)
+        {
+            if (lastFileName.compare(0, excluded_paths[i].size(), excluded_paths[i]) == 0)
+                lastFileExcluded = true;
+        }
+    }
+
+    return lastFileExcluded;
+  }
+
+void
+Traversal::addName(const string& name, SgNode* n)
+  {
+    if (name.size() < min_name_length)
+        return;
+
+    NameKind kind = nameKindOf(n);
+    if (comparisonRules.collects(kind) && isExcluded(n) == false)
+        addName(name, declarationOf(n, &name), kind);
+  }
+
+Declaration
+Traversal::declarationOf(SgNode* n, const string* name)
+  {
+    Declaration declaration;
+    declaration.node = n;
+    declaration.kind = nameTable.label(n->class_name());
+
+    string declaredName = SageInterface::get_name(n);
+    declaration.name = name != NULL && declaredName == *name ? NULL : nameTable.label(declaredName);
+
+    Sg_File_Info* fileInfo = n->get_file_info();
+    if (fileInfo != NULL)
+    {
+        declaration.file = nameTable.label(fileInfo->get_filenameString());
+        declaration.line = fileInfo->get_line();
+    }
+
+    return declaration;
+  }
+
+void
+Traversal::addName(const string& name, const Declaration& declaration, NameKind kind)
+  {
+    NameId id = nameTable.add(name, declaration, kind);
+
+    if (nameStream != NULL)
+        nameStream->addName(nameTable[id]);
+  }
+
+void
+Traversal::endScope(const Declaration& scope, NameId begin)
+  {
+    NameId end = nameTable.size();
+
+    // The names are scored once they are all extracted (see scoreScopes()).
+    if (nameStream != NULL)
+        nameStream->endScope(end - begin, scope);
+    else
+        scopeTree.add(scope, begin, end, reportBuffer);
+  }
+
+bool
+Traversal::replayNames(const string& fileName, bool scopes)
+  {
+    MappedFile stream;
+    if (stream.map(fileName) == false)
+        return false;
+
+    IndexReader in(stream.data, stream.data + stream.size);
+
+    const char* magic = in.position;
+    in.skip(8);
+    if (in.valid == false || memcmp(magic, "UVNNAMES", 8) != 0 || in.get32() != NameStream::Version)
+        return false;
+
+    return replayNames(in.position, in.end, scopes);
+  }
+
+bool
+Traversal::replayNames(const char* events, const char* end, bool scopes)
+  {
+    IndexReader in(events, end);
+
+    while (in.valid && in.position != in.end)
+    {
+        char event = *in.position;
+        in.skip(1);
+
+        if (event == NameStream::NameEvent)
+        {
+            string name = in.getString();
+            uint32_t kind = in.get32();
+            Declaration declaration = NameStream::getDeclaration(in, nameTable, &name);
+            if (in.valid == false || kind >= NumberOfNameKinds)
+                return false;
+
+            addName(name, declaration, (NameKind) kind);
+        }
+        else if (event == NameStream::ScopeEvent)
+        {
+            uint32_t numberOfNames = in.get32();
+            Declaration scope = NameStream::getDeclaration(in, nameTable);
+            if (in.valid == false || numberOfNames > nameTable.size())
+                return false;
+
+            if (scopes)
+                endScope(scope, nameTable.size() - numberOfNames);
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if (in.valid && scopes)
+        scoreScopes();
+
+    return in.valid;
+  }
+
+bool
+Traversal::headerScopeKey(const Declaration& scope, NameId begin, NameId end, uint64_t& key)
+  {
+    string fileName = scope.file;
+    if (fileName.empty() || inputFiles.find(fileName) != inputFiles.end())
+        return false;
+
+    map<string, uint64_t>& headerHashes = headerCache->headerHashes;
+    map<string, uint64_t>::iterator header = headerHashes.find(fileName);
+    if (header == headerHashes.end())
+        header = headerHashes.insert(make_pair(fileName, hashFileContents(fileName))).first;
+
+    if (header->second == 0)
+        return false;
+
+    // The same scope of the same header (which only gives the same matches
+    // if it collected the same names, nested the same way).
+    uint32_t line = scope.line;
+
+    key = hashBytes(fileName.c_str(), fileName.size());
+    key = hashBytes(&header->second, sizeof(header->second), key);
+    key = hashBytes(&line, sizeof(line), key);
+
+    for (NameId k = begin; k != end; ++k)
+    {
+        const NameStructureType& name = nameTable[k];
+        NameId group = incremental_mode ? name.group - begin : 0;
+
+        key = hashBytes(name.c_str(), name.size() + 1, key);
+        key = hashBytes(&group, sizeof(group), key);
+        key = hashBytes(&name.kind, sizeof(name.kind), key);
+    }
+
+    return true;
+  }
+
+void
+Traversal::processNode(SgNode* n, SynthesizedAttribute& synthesizedAttribute )
+  {
+    // Look for names of functions
+    SgFunctionDeclaration* functionDeclaration = isSgFunctionDeclaration(n);
+    if (functionDeclaration != NULL)
+    {
+        string name = functionDeclaration->get_name().str();
+
+        if (debug_level > 3)
+        {
+            SgFunctionDefinition* functionDefinition =
+                functionDeclaration->get_definition();
+            if (functionDefinition != NULL)
+                fprintf (stderr, "SgFunctionDefinition: %s \n",name.c_str());
+            else
+                fprintf (stderr, "SgFunctionDeclaration: %s \n",name.c_str());
+        }
+
+        addName(name, n);
+        // nameSet.insert(name);
+    }
+
+    SgInitializedName* initializedName = isSgInitializedName(n);
+    if (initializedName != NULL)
+    {
+        string name = initializedName->get_name().str();
+
+        if (debug_level > 3)
+            fprintf (stderr, "SgInitializedName: %s \n",name.c_str());
+
+        addName(name, n);
+        // nameSet.insert(name);
+    }
+
+    SgNamespaceDeclarationStatement* namespaceDeclaration = isSgNamespaceDeclarationStatement(n);
+    if (namespaceDeclaration != NULL)
+    {
+        string name = namespaceDeclaration->get_name().str();
+
+        if (debug_level > 3)
+            fprintf (stderr, "SgNamespaceDeclaration: %s \n",name.c_str());
+
+        addName(name, n);
+        // nameSet.insert(name);
+    }
+
+    synthesizedAttribute.end = nameTable.size();
+  }
+
+void
+ScopeScorer::scoreTile(PairTile& tile)
+  {
+    SimilarityKernel& kernel = SimilarityKernel::threadLocal();
+    Scorer&           scorer = Scorer::threadLocal();
+
+    vector<uint64_t> matches;
+    vector<size_t>   survivors;
+    vector< pair<size_t,float> > matched;
+
+    for (size_t ii = tile.iBegin; ii != tile.iEnd; ++ii)
+    {
+        NameId i_index = candidateIds[ii];
+        const NameStructureType* i = &nameTable[i_index];
+
+        // We only want to visit the lower triangular part of the n^2
+        // matchings of names to each other, and of that only the names
+        // whose length allows them to be similar.
+        size_t first = max(ii + 1, tile.jBegin);
+        size_t last  = min((size_t) candidateWindowEnd[ii], tile.jEnd);
+
+        if (first >= last)
+            continue;
+
+        // Candidates are never shorter than name i, so their length is the
+        // divisor of the similarity.  For a large scope only the candidate
+        // pairs of the LshIndex are considered.
+        ScoringCounters pruned;
+        survivors.clear();
+        if (lshIndex.active())
+        {
+            size_t partners = lshIndex.end(ii) - lshIndex.begin(ii);
+            tile.counters.prunedByLsh += (last - first) - partners;
+
+            for (const uint32_t* k = lshIndex.begin(ii); k != lshIndex.end(ii); ++k)
+            {
+                if (mayMatch(ii, *k, i->size(), candidates.length(*k), pruned))
+                    survivors.push_back(*k);
+            }
+        }
+        else
+        {
+            for (size_t k = first; k < last; ++k)
+            {
+                if (mayMatch(ii, k, i->size(), candidates.length(k), pruned))
+                    survivors.push_back(k);
+            }
+        }
+
+        tile.counters.prunedByGroup     += pruned.prunedByGroup;
+        tile.counters.prunedByKind      += pruned.prunedByKind;
+        tile.counters.canonical         += pruned.canonical;
+        tile.counters.prunedByHistogram += pruned.prunedByHistogram;
+
+        // Score what is left: the lane groups of the survivors at once if
+        // the prefilter rejected little (the batches compute the LcsRatio),
+        // otherwise one by one.
+        matched.clear();
+        if (similarity_metric == LcsRatio && lshIndex.active() == false &&
+            2 * survivors.size() > last - first)
+        {
+            tile.counters.scored += survivors.size();
+
+            matches.resize((survivors.size() + 63) / 64);
+            kernel.matchSelected(i->c_str(), i->size(),
+                                 candidates, &survivors[0], survivors.size(),
+                                 similarity_threshold, &matches[0]);
+
+            // As SimilarityKernel::similarity() computes it.
+            const unsigned* lengths = kernel.batchLengths();
+            for (size_t w = 0; w < matches.size(); ++w)
+            {
+                for (uint64_t bits = matches[w]; bits != 0; bits &= bits - 1)
+                {
+                    size_t s = 64 * w + __builtin_ctzll(bits);
+                    size_t k = survivors[s];
+
+                    float similarity = (float) lengths[s];
+                    similarity /= max(i->size(), (size_t) candidates.length(k));
+                    matched.push_back(pair<size_t,float> (k, similarity));
+                }
+            }
+        }
+        else
+        {
+            for (size_t s = 0; s < survivors.size(); ++s)
+            {
+                size_t k = survivors[s];
+                float similarity;
+
+                if (candidates.length(k) < ScoreMemo::MinLength)
+                {
+                    similarity = scorer.similarityAbove(i->c_str(), i->size(),
+                                                        candidates.name(k), candidates.length(k),
+                                                        similarity_threshold);
+                    ++tile.counters.scored;
+                }
+                else
+                {
+                    uint64_t key = ScoreMemo::key(i->stringId, nameTable[candidateIds[k]].stringId);
+                    if (scoreMemo.lookup(key, similarity) == false)
+                    {
+                        similarity = scorer.similarityAbove(i->c_str(), i->size(),
+                                                            candidates.name(k), candidates.length(k),
+                                                            similarity_threshold);
+                        tile.newScores.push_back(pair<uint64_t,float> (key, similarity));
+                        ++tile.counters.scored;
+                    }
+                    else
+                    {
+                        ++tile.counters.memoized;
+                    }
+                }
+
+                if (similarity > similarity_threshold)
+                    matched.push_back(pair<size_t,float> (k, similarity));
+            }
+        }
+
+        tile.counters.matches += matched.size();
+
+        for (size_t m = 0; m < matched.size(); ++m)
+        {
+            NameId j_index = candidateIds[matched[m].first];
+            float similarity = matched[m].second;
+
+            if (debug_level > 1)
+            {
+                fprintf(stderr, "\n\"%s\" and \"%s\" are %3.0f%% similar.\n\n",
+                        i->c_str(),
+                        nameTable[j_index].c_str(),
+                        similarity*100);
+            }
+
+            tile.results.push_back(NameMatch(i_index, j_index, similarity));
+        }
+    }
+  }
+
+void
+Traversal::scoreScopes()
+  {
+    if (scopeTree.empty())
+        return;
+
+    double start = secondsNow();
+    scopeTree.finish();
+
+    // A scope only depends on the scopes inside it (whose groups it
+    // compares), so the scopes of the same height above the innermost ones
+    // can be scored in any order: none of them contains another, so their
+    // ranges of names are disjoint.
+    size_t count = scopeTree.size();
+    vector<uint32_t> height(count, 0);
+    uint32_t maxHeight = 0;
+    for (size_t k = count; k-- > 0; )
+    {
+        uint32_t parent = scopeTree[k].parent;
+        if (parent != ScopeTree::NoParent)
+            height[parent] = max(height[parent], height[k] + 1);
+        maxHeight = max(maxHeight, height[k]);
+    }
+
+    vector< vector<size_t> > levels(maxHeight + 1);
+    for (size_t k = 0; k < count; ++k)
+        levels[height[k]].push_back(k);
+
+    // The scopes are reported in the order they ended (as the traversal
+    // found them), each as soon as it and those that ended before it are
+    // scored: a scope ends after those inside it, so a level reports all the
+    // scopes up to the first of a higher level not scored yet.
+    vector<uint32_t> ended(count);
+    for (size_t k = 0; k < count; ++k)
+        ended[scopeTree[k].order] = (uint32_t) k;
+
+    size_t reported = 0;
+    double output   = 0;
+
+    vector< vector<NameMatch> >       results(count);
+    vector< vector<MatchSpill::Run> > runs(count);
+    vector<ScopeStatistics>           costs(count);
+    size_t                            held = 0;
+
+    for (size_t level = 0; level < levels.size(); ++level)
+    {
+        // The small scopes (of a single tile) are scored side by side in
+        // ScopeTasks, the others one at a time with their tiles in parallel.
+        vector<ScopeTask> tasks;
+        vector<size_t>    large;
+        size_t            names = ScopeTask::Names;
+
+        for (size_t i = 0; i < levels[level].size(); ++i)
+        {
+            size_t k = levels[level][i];
+            size_t size = scopeTree[k].end - scopeTree[k].begin;
+
+            if (pool == NULL || size > PairTile::Size)
+            {
+                large.push_back(k);
+                continue;
+            }
+
+            if (names >= ScopeTask::Names)
+            {
+                tasks.push_back(ScopeTask(this, &results, &runs, &costs));
+                names = 0;
+            }
+
+            tasks.back().scopes.push_back(k);
+            names += size;
+        }
+
+        if (tasks.empty() == false)
+        {
+            vector<PoolTask*> work;
+            for (size_t t = 0; t < tasks.size(); ++t)
+                work.push_back(&tasks[t]);
+            pool->run(work);
+        }
+
+        for (size_t i = 0; i < large.size(); ++i)
+            scoreScope(scopeScorer, scopeTree[large[i]], results[large[i]], runs[large[i]], costs[large[i]]);
+
+        // The scores computed are known to the scopes of the next levels.
+        scopeScorer.flushScores();
+        for (size_t t = 0; t < taskScorers.size(); ++t)
+            taskScorers[t]->flushScores();
+
+        for (size_t i = 0; i < levels[level].size(); ++i)
+            held += results[levels[level][i]].size();
+
+        double reporting = secondsNow();
+        string* buffer = reportBuffer;
+        for (; reported < count && height[ended[reported]] <= level; ++reported)
+        {
+            size_t k = ended[reported];
+            held -= results[k].size();
+
+            reportBuffer = scopeTree[k].reportBuffer;
+            reportScope(scopeTree[k].declaration, results[k], runs[k]);
+            vector<NameMatch>().swap(results[k]);
+            vector<MatchSpill::Run>().swap(runs[k]);
+
+            statistics.totals.add(costs[k].counters);
+            ++statistics.scopes;
+            if (stats_mode)
+                statistics.scopeStatistics.push_back(costs[k]);
+        }
+        reportBuffer = buffer;
+        output += secondsNow() - reporting;
+
+        // The matches of the scopes scored but not reported yet wait for
+        // the scopes that ended before them: once they are more than the
+        // matchBudget, those of the scopes with the most of them spill until
+        // they are down to half of it.
+        if (matchBudget > 0 && held > matchBudget)
+        {
+            vector< pair<size_t, size_t> > largest;
+            for (size_t below = 0; below <= level; ++below)
+            {
+                for (size_t i = 0; i < levels[below].size(); ++i)
+                {
+                    size_t k = levels[below][i];
+                    if (results[k].empty() == false)
+                        largest.push_back(make_pair(results[k].size(), k));
+                }
+            }
+
+            sort(largest.begin(), largest.end(), greater< pair<size_t, size_t> >());
+            for (size_t i = 0; i < largest.size() && held > matchBudget / 2; ++i)
+            {
+                held -= largest[i].first;
+                matchSpill.write(results[largest[i].second], runs[largest[i].second]);
+            }
+        }
+    }
+
+    statistics.seconds[RunStatistics::ScoringPhase] += secondsNow() - start - output;
+    statistics.seconds[RunStatistics::OutputPhase]  += output;
+
+    scopeTree.clear();
+  }
+
+void
+Traversal::scoreScope(ScopeScorer& scorer, const ScopeTree::Scope& scope,
+                      vector<NameMatch>& results, vector<MatchSpill::Run>& runs,
+                      ScopeStatistics& cost)
+  {
+    NameId begin = scope.begin;
+    NameId end   = scope.end;
+
+    double start = secondsNow();
+    scorer.scopeCounters = ScoringCounters();
+
+    // The scorers share the matchBudget (those of the ScopeTasks running
+    // one per thread).
+    size_t scorers = (pool != NULL) ? pool->size() + 1 : 1;
+    scorer.spill        = (matchBudget > 0) ? &matchSpill : NULL;
+    scorer.spillMatches = max(matchBudget / scorers, MatchMerger::ChunkSize);
+
+    const uint32_t* partners = NULL;
+    if (comparisonRules.active())
+        partners = comparisonRules.partners(ComparisonRules::scopeKind(scope.declaration.kind));
+
+    // A scope in a header gives the same matches in every translation unit
+    // including the same version of the header.
+    uint64_t   headerKey = 0;
+    bool       cached = false;
+    bool       header = false;
+    Traversal& headers = *headerCache;
+    if (cache_headers)
+    {
+        pthread_mutex_lock(&headers.headerLock);
+        header = headerScopeKey(scope.declaration, begin, end, headerKey);
+
+        map<uint64_t, vector<NameMatch> >::iterator matches = headers.headerScopeMatches.end();
+        if (header)
+            matches = headers.headerScopeMatches.find(headerKey);
+
+        if (matches != headers.headerScopeMatches.end())
+        {
+            // They spill as those scored would (and are as sorted).
+            for (size_t m = 0; m < matches->second.size(); ++m)
+            {
+                const NameMatch& match = matches->second[m];
+                results.push_back(NameMatch(begin + match.first, begin + match.second,
+                                            match.similarity, match.canonical));
+                scorer.spillResults(results, &runs);
+            }
+            cached = true;
+        }
+        pthread_mutex_unlock(&headers.headerLock);
+    }
+
+    if (cached == false)
+    {
+        scorer.scoreNames(begin, end, results, partners, &runs);
+
+        if (header && runs.empty())
+        {
+            vector<NameMatch> matches;
+            for (size_t m = 0; m < results.size(); ++m)
+                matches.push_back(NameMatch(results[m].first - begin, results[m].second - begin,
+                                            results[m].similarity, results[m].canonical));
+
+            // Beyond its budget, the cache only keeps what it has.
+            pthread_mutex_lock(&headers.headerLock);
+            if (headers.headerBudget == 0 || headers.headerMatches + matches.size() <= headers.headerBudget)
+            {
+                if (headers.headerScopeMatches.insert(make_pair(headerKey, matches)).second)
+                    headers.headerMatches += matches.size();
+            }
+            pthread_mutex_unlock(&headers.headerLock);
+        }
+    }
+
+    cost.scope    = scope.declaration;
+    cost.names    = end - begin;
+    cost.counters = scorer.scopeCounters;
+    cost.seconds  = secondsNow() - start;
+
+    // Every pair in this scope has now been compared, so the enclosing
+    // scopes need only compare these names against names from elsewhere
+    // (unless the comparisonRules leave some of these pairs to them).
+    if (incremental_mode)
+    {
+        uint32_t kinds = 0;
+        if (comparisonRules.active())
+        {
+            for (NameId k = begin; k != end; ++k)
+                kinds |= 1u << nameTable[k].kind;
+        }
+
+        if (comparisonRules.complete(ComparisonRules::scopeKind(scope.declaration.kind), kinds))
+        {
+            for (NameId k = begin; k != end; ++k)
+                nameTable[k].group = begin;
+        }
+    }
+  }
+
+void
+Traversal::reportScope(const Declaration& scope, vector<NameMatch>& results,
+                       const vector<MatchSpill::Run>& runs)
+  {
+    if (runs.empty())
+    {
+        reportMatches(scope, results);
+        statistics.countThresholds(results);
+        return;
+    }
+
+    // The report of the scope is written a chunk at a time, as they come
+    // out of the merge.
+    MatchMerger merger(matchSpill, runs, results);
+    vector<NameMatch> chunk;
+    vector<NameMatch> next;
+
+    bool more  = merger.next(chunk);
+    bool opens = true;
+    while (more)
+    {
+        more = merger.next(next);
+        reportMatches(scope, chunk, opens, more == false);
+        statistics.countThresholds(chunk);
+
+        chunk.swap(next);
+        opens = false;
+    }
+  }
+
+void
+Traversal::reportMatches(const Declaration& scope, vector<NameMatch>& results, bool opens, bool closes)
+  {
+    vector<string> lcs(show_lcs ? results.size() : 0);
+    if (show_lcs)
+    {
+        // The subsequences are independent of each other.
+        vector<LcsTask> tasks;
+        for (size_t k = 0; k < results.size(); k += LcsTask::Size)
+            tasks.push_back(LcsTask(nameTable, results, lcs, k, min(k + LcsTask::Size, results.size())));
+
+        if (pool != NULL && tasks.size() > 1)
+        {
+            vector<PoolTask*> work;
+            for (size_t t = 0; t < tasks.size(); ++t)
+                work.push_back(&tasks[t]);
+            pool->run(work);
+        }
+        else
+        {
+            for (size_t t = 0; t < tasks.size(); ++t)
+                tasks[t].run();
+        }
+    }
+
+    // The structured formats have a line per match, and nothing else.
+    if (report_format != TextReport)
+    {
+        string text;
+        for (size_t k = 0; k < results.size(); ++k)
+        {
+            formatMatch(text, scope, results[k], show_lcs ? lcs[k] : string());
+
+            if (text.size() >= ReportWriter::BufferSize)
+            {
+                reportText(text);
+                text.clear();
+            }
+        }
+
+        reportText(text);
+        return;
+    }
+
+    // Output the resulting matches of any non-empty list of results
+    if (results.empty() == false)
+    {
+        if (opens)
+        {
+            report ("\n\n*******************************************************\n");
+            report ("Processing matches of name in "
+                    "scope = %p = %s = %s \n",
+                    scope.node,
+                    scope.kind,
+                    scope.name);
+        }
+
+        vector<NameMatch>::iterator i;
+        for (i = results.begin(); i != results.end(); ++i)
+        {
+            // Output the matching names
+
+            const NameStructureType& first  = nameTable[i->first];
+            const NameStructureType& second = nameTable[i->second];
+
+            const Declaration& firstDeclaration  = first.declaration;
+            const Declaration& secondDeclaration = second.declaration;
+
+            int similarityPercentage = 100 * i->similarity;
+
+            if (i->canonical)
+                report ("[canonical match]\n");
+            else
+                report ("[%d%% similarity]\n", similarityPercentage);
+
+            report ("\t%s:%s:%s\n"
+                    "\t%s:%s:%s\n",
+                    firstDeclaration.kind,
+                    firstDeclaration.name,
+                    first.c_str(),
+                    secondDeclaration.kind,
+                    secondDeclaration.name,
+                    second.c_str());
+
+            if (show_lcs)
+                report ("\tlongest common subsequence: %s\n", lcs[i - results.begin()].c_str());
+
+            report ("     %s:%s on line %d in file %s \n",
+                    firstDeclaration.kind,
+                    firstDeclaration.name,
+                    firstDeclaration.line,
+                    firstDeclaration.file);
+
+            report ("     %s:%s on line %d in file %s \n",
+                    secondDeclaration.kind,
+                    secondDeclaration.name,
+                    secondDeclaration.line,
+                    secondDeclaration.file);
+
+            report ("\n");
+        }
+
+        if (closes)
+            report ("******************************************************* \n\n");
+    }
+  }
+
+void
+Traversal::formatMatch(string& text, const Declaration& scope, const NameMatch& match,
+                       const string& lcs) const
+  {
+    const NameStructureType* names[] = { &nameTable[match.first], &nameTable[match.second] };
+
+    char similarity[32];
+    snprintf(similarity, sizeof(similarity), "%.3f", match.similarity);
+
+    if (report_format == JsonLinesReport)
+    {
+        text += "{\"similarity\":";
+        text += similarity;
+        text += ",\"scope\":{\"kind\":";
+        appendJson(text, scope.kind);
+        text += ",\"name\":";
+        appendJson(text, scope.name);
+        text += '}';
+
+        for (size_t k = 0; k < 2; ++k)
+        {
+            const Declaration& declaration = names[k]->declaration;
+
+            text += (k == 0) ? ",\"first\":{\"name\":" : ",\"second\":{\"name\":";
+            appendJson(text, names[k]->c_str());
+            text += ",\"kind\":";
+            appendJson(text, declaration.kind);
+            text += ",\"declaration\":";
+            appendJson(text, declaration.name);
+            text += ",\"file\":";
+            appendJson(text, declaration.file);
+
+            char line[32];
+            snprintf(line, sizeof(line), ",\"line\":%u}", declaration.line);
+            text += line;
+        }
+    }
+    else
+    {
+        char message[64];
+        if (match.canonical)
+            snprintf(message, sizeof(message), " only differ in case, underscores and digits");
+        else
+            snprintf(message, sizeof(message), " are %d%% similar", (int) (100 * match.similarity));
+
+        text += "{\"ruleId\":\"similar-names\",\"level\":\"note\",\"message\":{\"text\":";
+        appendJson(text, (string(names[0]->c_str()) + " and " + names[1]->c_str() + message).c_str());
+        text += "},\"locations\":[";
+        appendSarifLocation(text, names[0]->declaration);
+        text += "],\"relatedLocations\":[";
+        appendSarifLocation(text, names[1]->declaration);
+        text += "],\"properties\":{\"similarity\":";
+        text += similarity;
+        text += ",\"scope\":";
+        appendJson(text, scope.name);
+    }
+
+    if (match.canonical)
+        text += ",\"canonical\":true";
+
+    if (show_lcs)
+    {
+        text += ",\"lcs\":";
+        appendJson(text, lcs.c_str());
+    }
+
+    text += (report_format == JsonLinesReport) ? "}\n" : "}}\n";
+  }
+
+void
+ScopeScorer::scoreNames(NameId begin, NameId end, vector<NameMatch>& results,
+                        const uint32_t* partners, vector<MatchSpill::Run>* runs)
+  {
+    // Group the names of this scope by string, so that each pair of
+    // distinct strings is scored once however often they occur: unique
+    // string u (numbered in order of first occurrence) occurs as the names
+    // uniqueOccurrences[uniqueOccurrenceStart[u] .. uniqueOccurrenceStart[u + 1]).
+    if (uniqueOfString.size() < nameTable.numberOfStrings())
+        uniqueOfString.resize(nameTable.numberOfStrings(), MultipleGroups);
+
+    size_t reportedBefore = results.size();
+    size_t spilled = 0;
+
+    // The names of the kinds compared with nothing here are left out.
+    uint32_t allKinds[NumberOfNameKinds];
+    if (partners == NULL)
+    {
+        fill_n(allKinds, (int) NumberOfNameKinds, ~(uint32_t) 0);
+        partners = allKinds;
+    }
+
+    uniqueStrings.clear();
+    uniqueGroups.clear();
+    uniqueKinds.clear();
+    uniqueOccurrenceStart.assign(1, 0);
+
+    NameId compared = 0;
+    for (NameId k = begin; k != end; ++k)
+    {
+        const NameStructureType& name = nameTable[k];
+        if (partners[name.kind] == 0)
+            continue;
+
+        NameId& u = uniqueOfString[name.stringId];
+
+        if (u == MultipleGroups)
+        {
+            u = (NameId) uniqueStrings.size();
+            uniqueStrings.push_back(name.stringId);
+            uniqueGroups.push_back(name.group);
+            uniqueKinds.push_back(0);
+            uniqueOccurrenceStart.push_back(0);
+        }
+        else if (uniqueGroups[u] != name.group)
+        {
+            uniqueGroups[u] = MultipleGroups;
+        }
+
+        uniqueKinds[u] |= 1u << name.kind;
+        ++uniqueOccurrenceStart[u + 1];
+        ++compared;
+    }
+
+    size_t uniqueCount = uniqueStrings.size();
+
+    for (size_t u = 0; u < uniqueCount; ++u)
+        uniqueOccurrenceStart[u + 1] += uniqueOccurrenceStart[u];
+
+    uniqueOccurrences.resize(compared);
+    vector<NameId> fill(uniqueOccurrenceStart.begin(), uniqueOccurrenceStart.end() - 1);
+    for (NameId k = begin; k != end; ++k)
+    {
+        if (partners[nameTable[k].kind] != 0)
+            uniqueOccurrences[fill[uniqueOfString[nameTable[k].stringId]]++] = k;
+    }
+
+    // Without incremental mode every pair is compared, whatever the groups.
+    if (incremental == false)
+        uniqueGroups.assign(uniqueCount, MultipleGroups);
+
+    // Sort the strings by length (a counting sort, keeping strings of equal
+    // length in order of first occurrence), each represented by its first
+    // occurrence.  Empty names are left out since they are never similar
+    // to anything.
+    size_t maxLength = 0;
+    for (size_t u = 0; u < uniqueCount; ++u)
+        maxLength = max(maxLength, nameTable[uniqueOccurrences[uniqueOccurrenceStart[u]]].size());
+
+    vector<size_t> lengthStart(maxLength + 2, 0);
+    for (size_t u = 0; u < uniqueCount; ++u)
+        ++lengthStart[nameTable[uniqueOccurrences[uniqueOccurrenceStart[u]]].size() + 1];
+    for (size_t length = 1; length <= maxLength + 1; ++length)
+        lengthStart[length] += lengthStart[length - 1];
+
+    vector<NameId> sortedUniques(uniqueCount);
+    for (size_t u = 0; u < uniqueCount; ++u)
+        sortedUniques[lengthStart[nameTable[uniqueOccurrences[uniqueOccurrenceStart[u]]].size()]++] = (NameId) u;
+
+    // lengthStart[0] is now the end of the (leading) empty names.
+    sortedUniques.erase(sortedUniques.begin(), sortedUniques.begin() + lengthStart[0]);
+
+    // Pack them, in that order, for the batched comparisons.
+    size_t count = sortedUniques.size();
+
+    candidates.clear();
+    candidateIds.resize(count);
+    candidateGroups.resize(count);
+    candidateKinds.resize(count);
+    candidatePartners.resize(count);
+    candidateCanonicals.resize(count);
+    candidateSignatures.resize(count);
+    for (size_t k = 0; k < count; ++k)
+    {
+        NameId u = sortedUniques[k];
+        const NameStructureType& name = nameTable[uniqueOccurrences[uniqueOccurrenceStart[u]]];
+
+        candidates.add(name.c_str(), (uint32_t) name.size());
+        candidateIds[k] = uniqueOccurrences[uniqueOccurrenceStart[u]];
+        candidateGroups[k] = uniqueGroups[u];
+        candidateKinds[k] = uniqueKinds[u];
+        candidatePartners[k] = 0;
+        for (int kind = 0; kind < NumberOfNameKinds; ++kind)
+        {
+            if (uniqueKinds[u] & (1u << kind))
+                candidatePartners[k] |= partners[kind];
+        }
+        candidateSignatures[k] = nameTable.signature(name.stringId);
+        candidateCanonicals[k] = canonical_mode ? canonicalOf(name) : NameTable::NoString;
+    }
+    candidates.pack();
+
+    scopeCounters = ScoringCounters();
+    scopeCounters.pairs = (uint64_t) count * (count - (count > 0)) / 2;
+
+    // A pair can only be similar if the bound of the metric for their
+    // lengths is at least similarity_threshold; since the candidates are
+    // sorted by length the partners of each one are a contiguous window
+    // (see PruningBounds).
+    candidateWindowEnd.resize(count);
+    size_t windowEnd = 0;
+    for (size_t k = 0; k < count; ++k)
+    {
+        size_t length = candidates.length(k);
+
+        windowEnd = max(windowEnd, k + 1);
+        while (windowEnd < count &&
+               pruningBounds.lengthsMayMatch(length, candidates.length(windowEnd)))
+        {
+            ++windowEnd;
+        }
+
+        candidateWindowEnd[k] = (uint32_t) windowEnd;
+        scopeCounters.prunedByLength += count - windowEnd;
+    }
+
+    // The pairs of candidates with the same canonical name match whatever
+    // their lengths: every pair of each cluster, found in O(n) by chaining
+    // each candidate to the previous one of its cluster.  They are expanded
+    // into the pairs of their occurrences as they are found.
+    if (canonical_mode)
+    {
+        if (lastOfCanonical.size() < canonicalNames.numberOfStrings())
+            lastOfCanonical.resize(canonicalNames.numberOfStrings(), ~(uint32_t) 0);
+
+        candidateCanonicalPrevious.resize(count);
+        for (size_t k = 0; k < count; ++k)
+        {
+            NameId canonical = candidateCanonicals[k];
+            if (canonical == NameTable::NoString)
+                continue;
+
+            candidateCanonicalPrevious[k] = lastOfCanonical[canonical];
+            lastOfCanonical[canonical] = (uint32_t) k;
+
+            for (uint32_t j = candidateCanonicalPrevious[k]; j != ~(uint32_t) 0; j = candidateCanonicalPrevious[j])
+            {
+                if (candidateGroups[j] == candidateGroups[k] && candidateGroups[k] != MultipleGroups)
+                    continue;
+                if ((candidatePartners[j] & candidateKinds[k]) == 0)
+                    continue;
+
+                addOccurrences(NameMatch(candidateIds[j], candidateIds[k], 1.0, true), results, partners);
+                spilled += spillResults(results, runs);
+                ++scopeCounters.matches;
+            }
+        }
+
+        for (size_t k = 0; k < count; ++k)
+        {
+            if (candidateCanonicals[k] != NameTable::NoString)
+                lastOfCanonical[candidateCanonicals[k]] = ~(uint32_t) 0;
+        }
+    }
+
+    if (lsh_bands > 0 && count > LshIndex::MinCandidates)
+        lshIndex.build(candidates, candidateWindowEnd);
+    else
+        lshIndex.clear();
+
+    // Split the lower triangular part of the n^2 matchings into tiles (only
+    // those that intersect a length window), which are scored in parallel
+    // when there is more than one of them.  The candidate pairs of the
+    // LshIndex are split by rows only.  The tiles are scored a wave at a
+    // time, their matches being expanded into the results in between, so
+    // that only the matches of a wave are ever held by the tiles however
+    // large the scope.  Within a memory_budget the waves are only a few
+    // tiles for each thread, as each may have up to PairTile::Size^2 matches.
+    size_t wave = PairTile::Wave;
+    if (spill != NULL)
+        wave = 4 * ((pool != NULL) ? pool->size() : 1);
+
+    vector<PairTile> tiles;
+    size_t i0 = 0;
+    size_t j0 = 0;
+    while (i0 < count)
+    {
+        tiles.clear();
+        while (i0 < count && tiles.size() < wave)
+        {
+            size_t i1 = min(i0 + PairTile::Size, count);
+            size_t jEnd = lshIndex.active() ? i0 + 1 : candidateWindowEnd[i1 - 1];
+
+            if (lshIndex.active())
+                tiles.push_back(PairTile(this, i0, i1, i0, count));
+            else if (j0 < jEnd)
+                tiles.push_back(PairTile(this, i0, i1, j0, min(j0 + PairTile::Size, count)));
+
+            j0 += PairTile::Size;
+            if (j0 >= jEnd)
+            {
+                i0 = i1;
+                j0 = i1;
+            }
+        }
+
+        if (pool != NULL && tiles.size() > 1)
+        {
+            vector<PoolTask*> tasks;
+            for (size_t t = 0; t < tiles.size(); ++t)
+                tasks.push_back(&tiles[t]);
+
+            pool->run(tasks);
+        }
+        else
+        {
+            for (size_t t = 0; t < tiles.size(); ++t)
+                scoreTile(tiles[t]);
+        }
+
+        // Expand the matching pairs of strings into the pairs of their
+        // occurrences, and keep the scores the tiles computed for the rest
+        // of the project (those the memo still has room for).
+        for (size_t t = 0; t < tiles.size(); ++t)
+        {
+            vector<NameMatch>& matches = tiles[t].results;
+            for (size_t m = 0; m < matches.size(); ++m)
+                addOccurrences(matches[m], results, partners);
+
+            spilled += spillResults(results, runs);
+
+            if (scoreMemo.full(newScores.size()) == false)
+                newScores.insert(newScores.end(), tiles[t].newScores.begin(), tiles[t].newScores.end());
+
+            scopeCounters.add(tiles[t].counters);
+        }
+    }
+
+    // Repeated occurrences of a (non-empty) string are 100% similar.
+    float identical = 1.0;
+    if (identical > similarity_threshold)
+    {
+        for (size_t u = 0; u < uniqueCount; ++u)
+        {
+            NameId uBegin = uniqueOccurrenceStart[u];
+            NameId uEnd   = uniqueOccurrenceStart[u + 1];
+
+            if (nameTable[uniqueOccurrences[uBegin]].size() == 0)
+                continue;
+
+            for (NameId a = uBegin; a != uEnd; ++a)
+            {
+                for (NameId b = a + 1; b != uEnd; ++b)
+                {
+                    const NameStructureType& first  = nameTable[uniqueOccurrences[a]];
+                    const NameStructureType& second = nameTable[uniqueOccurrences[b]];
+
+                    if (incremental && first.group == second.group)
+                        continue;
+                    if ((partners[first.kind] & (1u << second.kind)) == 0)
+                        continue;
+
+                    results.push_back(NameMatch(uniqueOccurrences[a], uniqueOccurrences[b], identical));
+                }
+
+                spilled += spillResults(results, runs);
+            }
+        }
+    }
+
+    for (size_t u = 0; u < uniqueCount; ++u)
+        uniqueOfString[uniqueStrings[u]] = MultipleGroups;
+
+    scopeCounters.reported = spilled + results.size() - reportedBefore;
+
+    // Report the pairs in name table order.
+    sort(results.begin(), results.end());
+  }
+
+size_t
+ScopeScorer::spillResults(vector<NameMatch>& results, vector<MatchSpill::Run>* runs)
+  {
+    size_t size = results.size();
+    if (spill == NULL || runs == NULL || size < spillMatches)
+        return 0;
+
+    spill->write(results, *runs);
+    return size;
+  }
+
+void
+ScopeScorer::addOccurrences(const NameMatch& match, vector<NameMatch>& results, const uint32_t* partners)
+  {
+    NameId uA = uniqueOfString[nameTable[match.first].stringId];
+    NameId uB = uniqueOfString[nameTable[match.second].stringId];
+
+    for (NameId a = uniqueOccurrenceStart[uA]; a != uniqueOccurrenceStart[uA + 1]; ++a)
+    {
+        for (NameId b = uniqueOccurrenceStart[uB]; b != uniqueOccurrenceStart[uB + 1]; ++b)
+        {
+            NameId first  = uniqueOccurrences[a];
+            NameId second = uniqueOccurrences[b];
+
+            // Pairs within the same group were already compared (and
+            // reported) in a nested scope.
+            if (incremental && nameTable[first].group == nameTable[second].group)
+                continue;
+
+            if ((partners[nameTable[first].kind] & (1u << nameTable[second].kind)) == 0)
+                continue;
+
+            results.push_back(NameMatch(min(first, second), max(first, second),
+                                        match.similarity, match.canonical));
+        }
+    }
+  }
+
+NameId
+ScopeScorer::canonicalOf(const NameStructureType& name)
+  {
+    if (canonicalOfString.size() <= name.stringId)
+        canonicalOfString.resize(nameTable.numberOfStrings(), UnknownCanonical);
+
+    NameId& canonical = canonicalOfString[name.stringId];
+    if (canonical == UnknownCanonical)
+    {
+        string text = canonicalName(name.c_str(), name.size());
+        canonical = text.empty() ? NameTable::NoString : canonicalNames.addString(text);
+    }
+
+    return canonical;
+  }
+
+void
+ScopeScorer::flushScores()
+  {
+    for (size_t k = 0; k < newScores.size(); ++k)
+        scoreMemo.insert(newScores[k].first, newScores[k].second);
+
+    newScores.clear();
+  }
+
+
+InheritedAttribute
+Traversal::evaluateInheritedAttribute (
+    SgNode* astNode,
+    InheritedAttribute inheritedAttribute)
+  {
+    enterNode(astNode);
+
+    if (isSgScopeStatement(astNode) != NULL)
+    {
+        // Build a new inherited attribute.
+        return InheritedAttribute();
+    }
+
+    return inheritedAttribute;
+  }
+
+SynthesizedAttribute
+Traversal::evaluateSynthesizedAttribute (
+     SgNode* astNode,
+     InheritedAttribute inheritedAttribute,
+     SynthesizedAttributesList childAttributes )
+  {
+    SynthesizedAttribute result;
+
+    // The traversal is depth first, so the names collected by the children
+    // are adjacent ranges of the name table: the names at the parent
+    // (current node) are everything from the first non-empty child on.
+    result.begin = nameTable.size();
+    result.end   = nameTable.size();
+
+    SynthesizedAttributesList::iterator i;
+    for (i = childAttributes.begin(); i != childAttributes.end(); ++i)
+    {
+        if (i->empty() == false && i->begin < result.begin)
+        {
+            result.begin = i->begin;
+        }
+    }
+
+    leaveNode(astNode, result);
+
+    return result;
+  }
+
+void
+Traversal::enterNode(SgNode* n)
+  {
+    // The parameters of a function definition are traversed before it
+    // (as the parameter list of its declaration) but are names of its
+    // scope, which begins with them if they are the names just before it.
+    if (isSgFunctionDefinition(n) != NULL)
+    {
+        NameId begin = nameTable.size();
+        if (lastParameterList == n->get_parent() && parametersEnd == begin)
+            begin = parametersBegin;
+
+        functionScopeBegins.push_back(begin);
+    }
+
+    if (isSgSourceFile(n) != NULL)
+    {
+        currentInputFile = n->get_file_info()->get_filenameString();
+
+        // Collect the report of the input file for the index.
+        if (indexRecords.empty() == false)
+        {
+            map<string, IndexRecord*>::iterator record = indexRecords.find(currentInputFile);
+
+            currentRecord = record != indexRecords.end() ? record->second : NULL;
+            if (currentRecord != NULL)
+            {
+                currentRecord->traversed  = true;
+                currentRecord->nameTable  = &nameTable;
+                currentRecord->namesBegin = nameTable.size();
+                reportBuffer = &currentRecord->report;
+            }
+            lastDependency.clear();
+        }
+    }
+  }
+
+void
+Traversal::leaveNode(SgNode* n, SynthesizedAttribute& synthesizedAttribute)
+  {
+    if (isSgFunctionDefinition(n) != NULL)
+    {
+        NameId begin = functionScopeBegins.back();
+        functionScopeBegins.pop_back();
+
+        if (begin != nameTable.size())
+            endScope(declarationOf(n), begin);
+    }
+    else if (isSgScopeStatement(n) != NULL)
+    {
+        if (synthesizedAttribute.empty() == false)
+            endScope(declarationOf(n), synthesizedAttribute.begin);
+    }
+    else
+    {
+        processNode(n, synthesizedAttribute);
+
+        if (isSgFunctionParameterList(n) != NULL)
+        {
+            lastParameterList = n->get_parent();
+            parametersBegin   = synthesizedAttribute.begin;
+            parametersEnd     = nameTable.size();
+        }
+    }
+
+    if (currentRecord != NULL)
+    {
+        // The report of the input file depends on every file of its AST.
+        Sg_File_Info* fileInfo = n->get_file_info();
+        if (fileInfo != NULL && fileInfo->isCompilerGenerated() == false
+            && lastDependency != fileInfo->get_filename())
+        {
+            lastDependency = fileInfo->get_filename();
+            currentRecord->dependencies.insert(lastDependency);
+        }
+
+        if (isSgSourceFile(n) != NULL)
+        {
+            currentRecord->namesEnd = nameTable.size();
+            currentRecord = NULL;
+            reportBuffer  = NULL;
+        }
+    }
+  }
+
+void
+Traversal::extract(SgNode* n)
+  {
+    enterNode(n);
+
+    SynthesizedAttribute result;
+    result.begin = nameTable.size();
+
+    vector<SgNode*> children = n->get_traversalSuccessorContainer();
+    for (size_t i = 0; i < children.size(); ++i)
+    {
+        SgNode* child = children[i];
+
+        // Names are only declared by statements (and the SgInitializedNames
+        // of declarations), not in expressions.
+        if (child == NULL || isSgExpression(child) != NULL)
+            continue;
+
+        // As traverseInputFiles(), skip what the input file includes.
+        if (input_files_only && isSgFile(child) == NULL)
+        {
+            Sg_File_Info* fileInfo = child->get_file_info();
+            if (fileInfo != NULL && fileInfo->isCompilerGenerated() == false
+                && currentInputFile != fileInfo->get_filename())
+                continue;
+        }
+
+        extract(child);
+    }
+
+    result.end = nameTable.size();
+    leaveNode(n, result);
+  }
+
+void
+Traversal::extractFiles(SgProject* project)
+  {
+    // Each file has a global scope of its own, so their names never meet:
+    // the traversals of the files only share the header cache.  The frontend
+    // is done with the ASTs of all the files by now, and the traversals
+    // only read their nodes (and the table of file names of Sg_File_Info),
+    // so they can visit the files side by side without a lock.
+    vector<FileTask> tasks;
+    for (int i = 0; i < project->numberOfFiles(); ++i)
+    {
+        Traversal* traversal = new Traversal(1);
+        traversal->inputFiles   = inputFiles;
+        traversal->indexRecords = indexRecords;
+        traversal->headerCache  = headerCache;
+        traversal->budgetMemory(memory_budget / pool->size());
+        fileTraversals.push_back(traversal);
+
+        tasks.push_back(FileTask(&project->get_file(i), traversal));
+    }
+
+    vector<PoolTask*> work;
+    for (size_t t = 0; t < tasks.size(); ++t)
+        work.push_back(&tasks[t]);
+    pool->run(work);
+
+    double start = secondsNow();
+    for (size_t t = 0; t < tasks.size(); ++t)
+    {
+        reportText(tasks[t].report);
+        string().swap(tasks[t].report);
+
+        statistics.add(tasks[t].traversal->statistics);
+    }
+    statistics.seconds[RunStatistics::OutputPhase] += secondsNow() - start;
+  }
+
+size_t
+Traversal::numberOfNames() const
+  {
+    size_t names = nameTable.size();
+    for (size_t k = 0; k < fileTraversals.size(); ++k)
+        names += fileTraversals[k]->numberOfNames();
+
+    return names;
+  }
+
+/**
+ * \return false unless text is a threshold in [0, 1), stored in threshold.
+ */
+bool
+parseThreshold(const char* text, float& threshold)
+  {
+    char* end;
+    double value = strtod(text, &end);
+    if (end == text || *end != '\0' || value < 0 || value >= 1)
+        return false;
+
+    threshold = (float) value;
+    return true;
+  }
+
+/**
+ * Read the options in the configuration file fileName: one per line, with
+ * or without the leading "--" (blank lines and lines starting with '#'
+ * being ignored).  \return false if it can't be read.
+ */
+bool
+readConfiguration(const string& fileName, vector<string>& options)
+  {
+    FILE* file = fopen(fileName.c_str(), "r");
+    if (file == NULL)
+        return false;
+
+    char line[4096];
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        char* begin = line;
+        while (isspace((unsigned char) *begin))
+            ++begin;
+
+        char* end = begin + strlen(begin);
+        while (end > begin && isspace((unsigned char) end[-1]))
+            --end;
+
+        if (begin == end || *begin == '#')
+            continue;
+
+        string option(begin, end);
+        options.push_back(option[0] == '-' ? option : "--" + option);
+    }
+
+    fclose(file);
+    return true;
+  }
+
+/**
+ * Remove the options understood by this tool from the command line so
+ * that the remainder can be handed to the ROSE frontend.
+ *
+ *   --incremental   compare each pair of names only once, in the innermost
+ *                   scope containing both (see incremental_mode)
+ *   --threads=N     score the pairs of names of large scopes, and the small
+ *                   scopes side by side, on N threads (or extract and score
+ *                   the input files side by side, if at least N)
+ *   --memory-budget=MB
+ *                   hold no more than about MB megabytes of matches and
+ *                   scores while scoring, spilling the matches to a
+ *                   temporary file beyond it (see memory_budget)
+ *   --show-lcs      report a longest common subsequence of each match
+ *   --input-files-only
+ *                   only traverse the input files, not their headers
+ *   --exclude-system-headers
+ *                   ignore the names declared in system headers
+ *   --exclude-path=DIR
+ *                   ignore the names declared in files under DIR
+ *   --cache-headers compute the matches of scopes in headers only once
+ *   --index=FILE    only parse the input files changed since the run that
+ *                   wrote FILE, replaying the reports of the others
+ *   --fast-extraction
+ *                   only build and visit what the names need
+ *   --emit-names=FILE
+ *                   write the names to FILE instead of scoring them
+ *   --names=FILE    score the names written to FILE by --emit-names
+ *   --pipeline      parse the input files one at a time, scoring each while
+ *                   the next is parsed
+ *   --shard-plan=TABLE
+ *                   plan the comparison of all the --names as one scope
+ *   --shard-chunks=N
+ *                   number of chunks of the names in the plan
+ *   --shard-score=TABLE:K
+ *                   score block K of the plan
+ *   --shard-merge=TABLE
+ *                   report the scores of all the blocks of the plan
+ *   --metric=M      compare the names by the metric M: lcs (the default),
+ *                   ro (Ratcliff/Obershelp) or levenshtein
+ *   --threshold=T   report the pairs more than T similar (0.75 by default)
+ *   --thresholds=T1,T2,...
+ *                   also count the matches more than each of them, scoring
+ *                   once at the lowest (see threshold_bins)
+ *   --min-name-length=N
+ *                   leave the names of fewer than N characters out
+ *   --config=FILE   read options from FILE, one per line (see
+ *                   readConfiguration())
+ *   --lsh-bands=B   in scopes of many names only score the pairs of names
+ *                   found by locality-sensitive hashing with B bands
+ *   --lsh-rows=R    of R MinHash values each (3 by default)
+ *   --format=F      write the report as text (the default), jsonl (a JSON
+ *                   object per match) or sarif
+ *   --output=FILE   write the report to FILE instead of standard output
+ *   --canonical     report the names only differing in case, underscores and
+ *                   digits as matches without scoring them
+ *   --compare=RULE  only compare the kinds of names of the RULEs (see
+ *                   ComparisonRules), e.g. local,parameter@function,block
+ *   --stats         print where the time went, and the scopes that took the
+ *                   longest to score, to standard error
+ *   --stats-output=FILE
+ *                   also write the counters of every scope to FILE
+ *   --debug=N       print the names (N > 3) and the matches (N > 1) as they
+ *                   are found, to standard error
+ *   --benchmark     time the kernels, a synthetic scope tree and the input
+ *                   files instead of comparing their names
+ *   --benchmark-baseline=FILE
+ *                   compare the times to those in FILE (or write it)
+ *   --benchmark-tree=DxB
+ *                   make the synthetic tree D levels of B scopes deep
+ *   --query=INDEX   answer the queries of standard input about the names of
+ *                   the INDEX (see runQueries())
+ */
+void
+processCommandLine(vector<string>& argvList)
+  {
+    // The configurations read so far: one read again would include itself.
+    set<string> configurations;
+
+    vector<string>::iterator i = argvList.begin();
+    while (i != argvList.end())
+      {
+        if (i->compare(0, 9, "--config=") == 0)
+          {
+            // The options of the file take the place of this one.
+            vector<string> options;
+            char path[PATH_MAX];
+            if (realpath(i->c_str() + 9, path) == NULL || readConfiguration(path, options) == false)
+              {
+                fprintf(stderr, "Error: could not read the configuration in %s\n", i->c_str());
+                exit(1);
+              }
+
+            if (configurations.insert(path).second == false)
+              {
+                fprintf(stderr, "Error: the configuration in %s is read more than once\n", i->c_str());
+                exit(1);
+              }
+
+            size_t position = i - argvList.begin();
+            argvList.erase(i);
+            argvList.insert(argvList.begin() + position, options.begin(), options.end());
+            i = argvList.begin() + position;
+          }
+        else if (*i == "--incremental")
+          {
+            incremental_mode = true;
+            i = argvList.erase(i);
+          }
+        else if (i->compare(0, 10, "--threads=") == 0)
+          {
+            int threads = atoi(i->c_str() + 10);
+            if (threads < 1)
+              {
+                fprintf(stderr, "Error: invalid number of threads in %s\n", i->c_str());
+                exit(1);
+              }
+
+            number_of_threads = threads;
+            i = argvList.erase(i);
+          }
+        else if (i->compare(0, 16, "--memory-budget=") == 0)
+          {
+            int megabytes = atoi(i->c_str() + 16);
+            if (megabytes < 1)
+              {
+                fprintf(stderr, "Error: invalid memory budget in %s\n", i->c_str());
+                exit(1);
+              }
+
+            memory_budget = (size_t) megabytes << 20;
+            i = argvList.erase(i);
+          }
+        else if (*i == "--show-lcs")
+          {
+            show_lcs = true;
+            i = argvList.erase(i);
+          }
+        else if (*i == "--input-files-only")
+          {
+            input_files_only = true;
+            i = argvList.erase(i);
+          }
+        else if (*i == "--exclude-system-headers")
+          {
+            exclude_system_headers = true;
+            i = argvList.erase(i);
+          }
+        else if (i->compare(0, 15, "--exclude-path=") == 0)
+          {
+            excluded_paths.push_back(i->substr(15));
+            i = argvList.erase(i);
+          }
+        else if (*i == "--cache-headers")
+          {
+            cache_headers = true;
+            i = argvList.erase(i);
+          }
+        else if (i->compare(0, 8, "--index=") == 0)
+          {
+            index_file = i->substr(8);
+            i = argvList.erase(i);
+          }
+        else if (*i == "--fast-extraction")
+          {
+            fast_extraction = true;
+            i = argvList.erase(i);
+          }
+        else if (i->compare(0, 13, "--emit-names=") == 0)
+          {
+            emit_names_file = i->substr(13);
+            i = argvList.erase(i);
+          }
+        else if (i->compare(0, 8, "--names=") == 0)
+          {
+            name_stream_files.push_back(i->substr(8));
+            i = argvList.erase(i);
+          }
+        else if (*i == "--pipeline")
+          {
+            pipeline_mode = true;
+            i = argvList.erase(i);
+          }
+        else if (i->compare(0, 13, "--shard-plan=") == 0)
+          {
+            shard_phase = PlanShards;
+            shard_table = i->substr(13);
+            i = argvList.erase(i);
+          }
+        else if (i->compare(0, 15, "--shard-chunks=") == 0)
+          {
+            int chunks = atoi(i->c_str() + 15);
+            if (chunks < 1)
+              {
+                fprintf(stderr, "Error: invalid number of chunks in %s\n", i->c_str());
+                exit(1);
+              }
+
+            shard_chunks = chunks;
+            i = argvList.erase(i);
+          }
+        else if (i->compare(0, 14, "--shard-score=") == 0)
+          {
+            size_t colon = i->rfind(':');
+            if (colon == string::npos || colon < 14)
+              {
+                fprintf(stderr, "Error: no block in %s\n", i->c_str());
+                exit(1);
+              }
+
+            char* end;
+            long block = strtol(i->c_str() + colon + 1, &end, 10);
+            if (end == i->c_str() + colon + 1 || *end != '\0' || block < 0 || block > UINT_MAX)
+              {
+                fprintf(stderr, "Error: invalid block in %s\n", i->c_str());
+                exit(1);
+              }
+
+            shard_phase = ScoreShard;
+            shard_table = i->substr(14, colon - 14);
+            shard_block = (unsigned) block;
+            i = argvList.erase(i);
+          }
+        else if (i->compare(0, 14, "--shard-merge=") == 0)
+          {
+            shard_phase = MergeShards;
+            shard_table = i->substr(14);
+            i = argvList.erase(i);
+          }
+        else if (i->compare(0, 9, "--format=") == 0)
+          {
+            string format = i->substr(9);
+            if (format == "text")
+                report_format = TextReport;
+            else if (format == "jsonl")
+                report_format = JsonLinesReport;
+            else if (format == "sarif")
+                report_format = SarifReport;
+            else
+              {
+                fprintf(stderr, "Error: unknown format in %s\n", i->c_str());
+                exit(1);
+              }
+
+            i = argvList.erase(i);
+          }
+        else if (*i == "--canonical")
+          {
+            canonical_mode = true;
+            i = argvList.erase(i);
+          }
+        else if (i->compare(0, 10, "--compare=") == 0)
+          {
+            if (comparisonRules.add(i->substr(10)) == false)
+              {
+                fprintf(stderr, "Error: invalid rule in %s\n", i->c_str());
+                exit(1);
+              }
+
+            i = argvList.erase(i);
+          }
+        else if (*i == "--stats")
+          {
+            stats_mode = true;
+            i = argvList.erase(i);
+          }
+        else if (i->compare(0, 15, "--stats-output=") == 0)
+          {
+            stats_mode = true;
+            stats_file = i->substr(15);
+            i = argvList.erase(i);
+          }
+        else if (i->compare(0, 8, "--debug=") == 0)
+          {
+            debug_level = atoi(i->c_str() + 8);
+            i = argvList.erase(i);
+          }
+        else if (*i == "--benchmark")
+          {
+            benchmark_mode = true;
+            i = argvList.erase(i);
+          }
+        else if (i->compare(0, 21, "--benchmark-baseline=") == 0)
+          {
+            benchmark_baseline = i->substr(21);
+            i = argvList.erase(i);
+          }
+        else if (i->compare(0, 17, "--benchmark-tree=") == 0)
+          {
+            int depth, breadth;
+            if (sscanf(i->c_str() + 17, "%dx%d", &depth, &breadth) != 2 || depth < 0 || breadth < 1)
+              {
+                fprintf(stderr, "Error: invalid tree in %s\n", i->c_str());
+                exit(1);
+              }
+
+            benchmark_depth   = depth;
+            benchmark_breadth = breadth;
+            i = argvList.erase(i);
+          }
+        else if (i->compare(0, 8, "--query=") == 0)
+          {
+            query_index = i->substr(8);
+            i = argvList.erase(i);
+          }
+        else if (i->compare(0, 9, "--output=") == 0)
+          {
+            output_file = i->substr(9);
+            i = argvList.erase(i);
+          }
+        else if (i->compare(0, 12, "--lsh-bands=") == 0)
+          {
+            int bands = atoi(i->c_str() + 12);
+            if (bands < 0)
+              {
+                fprintf(stderr, "Error: invalid number of bands in %s\n", i->c_str());
+                exit(1);
+              }
+
+            lsh_bands = bands;
+            i = argvList.erase(i);
+          }
+        else if (i->compare(0, 11, "--lsh-rows=") == 0)
+          {
+            int rows = atoi(i->c_str() + 11);
+            if (rows < 1)
+              {
+                fprintf(stderr, "Error: invalid number of rows in %s\n", i->c_str());
+                exit(1);
+              }
+
+            lsh_rows = rows;
+            i = argvList.erase(i);
+          }
+        else if (i->compare(0, 12, "--threshold=") == 0)
+          {
+            if (parseThreshold(i->c_str() + 12, similarity_threshold) == false)
+              {
+                fprintf(stderr, "Error: invalid threshold in %s\n", i->c_str());
+                exit(1);
+              }
+
+            i = argvList.erase(i);
+          }
+        else if (i->compare(0, 13, "--thresholds=") == 0)
+          {
+            threshold_bins.clear();
+
+            string list = i->substr(13);
+            size_t begin = 0;
+            while (begin <= list.size())
+              {
+                size_t end = list.find(',', begin);
+                if (end == string::npos)
+                    end = list.size();
+
+                float threshold;
+                if (parseThreshold(list.substr(begin, end - begin).c_str(), threshold) == false)
+                  {
+                    fprintf(stderr, "Error: invalid threshold in %s\n", i->c_str());
+                    exit(1);
+                  }
+
+                threshold_bins.push_back(threshold);
+                begin = end + 1;
+              }
+
+            sort(threshold_bins.begin(), threshold_bins.end());
+            threshold_bins.erase(unique(threshold_bins.begin(), threshold_bins.end()), threshold_bins.end());
+            i = argvList.erase(i);
+          }
+        else if (i->compare(0, 18, "--min-name-length=") == 0)
+          {
+            char* end;
+            long length = strtol(i->c_str() + 18, &end, 10);
+            if (end == i->c_str() + 18 || *end != '\0' || length < 0)
+              {
+                fprintf(stderr, "Error: invalid length in %s\n", i->c_str());
+                exit(1);
+              }
+
+            min_name_length = length;
+            i = argvList.erase(i);
+          }
+        else if (i->compare(0, 9, "--metric=") == 0)
+          {
+            string metric = i->substr(9);
+            if (metric == "lcs")
+                similarity_metric = LcsRatio;
+            else if (metric == "ro")
+                similarity_metric = RatcliffObershelp;
+            else if (metric == "levenshtein")
+                similarity_metric = Levenshtein;
+            else
+              {
+                fprintf(stderr, "Error: unknown metric in %s\n", i->c_str());
+                exit(1);
+              }
+
+            i = argvList.erase(i);
+          }
+        else
+          {
+            ++i;
+          }
+      }
+
+    // The matches of all the bins are found at the lowest of them.
+    if (threshold_bins.empty() == false)
+        similarity_threshold = threshold_bins.front();
+  }
+
+/**
+ * \return true if the command line argument is a source file for ROSE.
+ */
+bool
+isSourceFileName(const string& argument)
+  {
+    static const char* extensions[] =
+      {
+        ".C", ".c", ".cc", ".cp", ".cpp", ".cxx", ".c++", ".CPP", NULL
+      };
+
+    if (argument.empty() || argument[0] == '-')
+        return false;
+
+    size_t dot = argument.rfind('.');
+    if (dot == string::npos)
+        return false;
+
+    for (size_t i = 0; extensions[i] != NULL; ++i)
+      {
+        if (argument.compare(dot, string::npos, extensions[i]) == 0)
+            return true;
+      }
+
+    return false;
+  }
+
+/**
+ * Append the options on the command line, i.e. everything but the program
+ * name and the input files (see isSourceFileName()), to options, with the
+ * values of the options taking one in the next argument.  \return false,
+ * reporting it, on an argument that is neither an option nor an input file.
+ */
+bool
+separateOptions(const vector<string>& argvList, vector<string>& options)
+  {
+    static const char* valueOptions[] =
+      {
+        "-I", "-D", "-U", "-o", "-include", "-isystem", NULL
+      };
+
+    for (size_t i = 1; i < argvList.size(); ++i)
+      {
+        if (isSourceFileName(argvList[i]))
+            continue;
+
+        if (argvList[i].empty() || argvList[i][0] != '-')
+          {
+            fprintf(stderr, "Error: %s is neither an option nor a source file\n", argvList[i].c_str());
+            return false;
+          }
+
+        options.push_back(argvList[i]);
+        for (size_t k = 0; valueOptions[k] != NULL; ++k)
+          {
+            if (argvList[i] == valueOptions[k] && i + 1 < argvList.size())
+                options.push_back(argvList[++i]);
+          }
+      }
+
+    return true;
+  }
+
+/**
+ * \return the hash of everything but the input files on the command line
+ * (i.e. the ROSE options) and the options of this tool affecting the reports.
+ */
+uint64_t
+configurationHash(const vector<string>& argvList)
+  {
+    uint64_t hash = hashBytes(&SimilarityIndex::Version, sizeof(SimilarityIndex::Version));
+
+    for (size_t i = 1; i < argvList.size(); ++i)
+      {
+        if (isSourceFileName(argvList[i]) == false)
+            hash = hashBytes(argvList[i].c_str(), argvList[i].size() + 1, hash);
+      }
+
+    bool options[] = { incremental_mode, show_lcs, input_files_only, exclude_system_headers,
+                       fast_extraction, canonical_mode };
+    hash = hashBytes(options, sizeof(options), hash);
+    hash = hashBytes(&similarity_threshold, sizeof(similarity_threshold), hash);
+    hash = hashBytes(&similarity_metric, sizeof(similarity_metric), hash);
+    hash = hashBytes(&min_name_length, sizeof(min_name_length), hash);
+
+    unsigned lsh[] = { lsh_bands, lsh_rows };
+    hash = hashBytes(lsh, sizeof(lsh), hash);
+    hash = hashBytes(&report_format, sizeof(report_format), hash);
+    hash = comparisonRules.hash(hash);
+
+    for (size_t i = 0; i < excluded_paths.size(); ++i)
+        hash = hashBytes(excluded_paths[i].c_str(), excluded_paths[i].size() + 1, hash);
+
+    return hash;
+  }
+
+/**
+ * Extract the names of the project with the traversal chosen by the options.
+ * With a pool of threads and at least as many files to extract (rather than
+ * to stream), the files are also scored and reported, as
+ * Traversal::extractFiles(): with fewer, the threads of the pool are better
+ * spent on the tiles of the large scopes, of which a file may have one.
+ */
+void
+extractNames(SgProject* project, Traversal& traversal)
+  {
+    // Build the inherited attribute
+    InheritedAttribute inheritedAttribute;
+
+    double start = secondsNow();
+
+    for (int i = 0; i < project->numberOfFiles(); ++i)
+    {
+        traversal.inputFiles.insert(
+            project->get_file(i).get_file_info()->get_filenameString());
+    }
+
+    if (traversal.pool != NULL && traversal.nameStream == NULL
+        && project->numberOfFiles() >= (int) traversal.pool->size())
+    {
+        // The traversals of the files account for their own time.
+        traversal.extractFiles(project);
+        return;
+    }
+
+    // Call the traversal starting at the project (root) node of the AST
+    if (fast_extraction)
+    {
+        // This only visits the statements and declarations.
+        traversal.extract(project);
+    }
+    else if (input_files_only)
+    {
+        // This just traverses the named input files (excluding header files).
+        traversal.traverseInputFiles(project,inheritedAttribute);
+    }
+    else
+    {
+        // For more common use this traverses the input file and all of its header files.
+        traversal.traverse(project,inheritedAttribute);
+    }
+
+    traversal.statistics.seconds[RunStatistics::TraversalPhase] += secondsNow() - start;
+  }
+
+/**
+ * An input file on its way through the pipeline (see runPipeline()).
+ */
+class PipelineBatch
+  {
+    public:
+      IndexRecord* record;   ///< Where its report goes if it is indexed (else the output)
+      string       events;   ///< Its names (see NameStream)
+      string       report;
+  };
+
+/**
+ * The stages of the pipeline after the extraction, each on a thread of its
+ * own: the scoring of the names of each input file, then its report.
+ */
+class PipelineStages
+  {
+    public:
+      /// Number of input files extracted (or scored) ahead of the next stage.
+      static const size_t Capacity = 2;
+
+      PipelineStages()
+        : extracted(Capacity),
+          scored(Capacity)
+        {}
+
+      static void* score(void* stages);
+      static void* output(void* stages);
+
+      BoundedQueue<PipelineBatch*> extracted;
+      BoundedQueue<PipelineBatch*> scored;
+
+      /// Scores the names of all the input files, in order.
+      Traversal scorer;
+  };
+
+const size_t PipelineStages::Capacity;
+
+void*
+PipelineStages::score(void* argument)
+  {
+    PipelineStages& stages = *(PipelineStages*) argument;
+
+    PipelineBatch* batch;
+    while (stages.extracted.pop(batch))
+    {
+        stages.scorer.reportBuffer = &batch->report;
+        stages.scorer.replayNames(batch->events.data(), batch->events.data() + batch->events.size());
+        string().swap(batch->events);
+
+        stages.scored.push(batch);
+    }
+
+    stages.scored.close();
+    return NULL;
+  }
+
+void*
+PipelineStages::output(void* argument)
+  {
+    PipelineStages& stages = *(PipelineStages*) argument;
+
+    PipelineBatch* batch;
+    while (stages.scored.pop(batch))
+    {
+        if (batch->record != NULL)
+            batch->record->report.swap(batch->report);
+        else
+            reportWriter.write(batch->report);
+
+        delete batch;
+    }
+
+    return NULL;
+  }
+
+/**
+ * Parse the inputs one at a time, each in a project of its own which is
+ * freed once its names are extracted (by the extractor), while the names
+ * of the previous inputs are scored and reported by the PipelineStages.
+ * The reports of the inputs having records go to them instead.  \return
+ * false if the options can't be told from the inputs (see separateOptions()).
+ */
+bool
+runPipeline(const vector<string>& argvList, const vector<string>& inputs,
+            const vector<IndexRecord*>& records, Traversal& extractor)
+  {
+    // Each input is parsed with all the options, but none of the other inputs.
+    vector<string> options(1, argvList[0]);
+    if (separateOptions(argvList, options) == false)
+        return false;
+
+    PipelineStages stages;
+
+    // The header cache of the scorer needs to know what is not a header.
+    for (size_t k = 0; k < inputs.size(); ++k)
+    {
+        char path[PATH_MAX];
+        if (realpath(inputs[k].c_str(), path) != NULL)
+            stages.scorer.inputFiles.insert(path);
+    }
+
+    pthread_t scoring, output;
+    pthread_create(&scoring, NULL, PipelineStages::score, &stages);
+    pthread_create(&output, NULL, PipelineStages::output, &stages);
+
+    // The names extracted are kept in memory and handed to the scorer.
+    NameStream names;
+    extractor.nameStream = &names;
+
+    for (size_t k = 0; k < inputs.size(); ++k)
+    {
+        vector<string> fileArguments(options);
+        fileArguments.push_back(inputs[k]);
+
+        double start = secondsNow();
+        SgProject* project = new SgProject(fileArguments);
+        extractor.statistics.seconds[RunStatistics::FrontendPhase] += secondsNow() - start;
+
+        extractNames(project, extractor);
+
+        PipelineBatch* batch = new PipelineBatch;
+        batch->record = records[k];
+        names.takeEvents(batch->events);
+
+        SageInterface::deleteAST(project);
+
+        stages.extracted.push(batch);
+    }
+
+    stages.extracted.close();
+
+    pthread_join(scoring, NULL);
+    pthread_join(output, NULL);
+
+    extractor.nameStream = NULL;
+    extractor.statistics.add(stages.scorer.statistics);
+    return true;
+  }
+
+/**
+ * Plan the sharded comparison of all the names of the traversal (the
+ * names of the --names streams) into the ShardTable tableFile.
+ */
+int
+planShards(Traversal& traversal, const string& tableFile)
+  {
+    NameTable& nameTable = traversal.nameTable;
+
+    vector<bool>   seen(nameTable.numberOfStrings(), false);
+    vector<string> strings;
+    for (NameId k = 0; k < nameTable.size(); ++k)
+    {
+        const NameStructureType& name = nameTable[k];
+        if (name.size() > 0 && seen[name.stringId] == false)
+        {
+            seen[name.stringId] = true;
+            strings.push_back(name.c_str());
+        }
+    }
+
+    ShardTable table;
+    table.plan(strings, shard_chunks);
+
+    if (table.write(tableFile) == false)
+    {
+        fprintf(stderr, "Error: could not write the shard table %s\n", tableFile.c_str());
+        return 1;
+    }
+
+    unsigned numberOfChunks = table.chunkBegin.size() - 1;
+    printf("%u strings in %u chunks: %u blocks of pairs to score (of %u)\n",
+           (unsigned) table.strings.size(), numberOfChunks, (unsigned) table.blocks.size(),
+           numberOfChunks * (numberOfChunks + 1) / 2);
+    return 0;
+  }
+
+/**
+ * Score the block of pairs of strings of the ShardTable tableFile.
+ */
+int
+scoreShard(Traversal& traversal, const string& tableFile, unsigned block)
+  {
+    ShardTable table;
+    if (table.read(tableFile) == false || block >= table.blocks.size())
+    {
+        fprintf(stderr, "Error: no block %u in the shard table %s\n", block, tableFile.c_str());
+        return 1;
+    }
+
+    similarity_threshold = table.threshold;
+    similarity_metric    = table.metric;
+    pruningBounds.compute();
+
+    // The blocks only record similarities (which the canonical matches
+    // don't have), so every pair is scored.
+    canonical_mode = false;
+
+    // The strings of the two chunks are the names of a single scope, in
+    // two groups when they differ so that only the pairs across the chunks
+    // are scored (incrementally).
+    unsigned I = table.blocks[block].first;
+    unsigned J = table.blocks[block].second;
+
+    NameTable& nameTable = traversal.nameTable;
+    Declaration declaration;
+
+    NameId beginI = nameTable.size();
+    for (uint32_t k = table.chunkBegin[I]; k != table.chunkBegin[I + 1]; ++k)
+        traversal.addName(table.strings[k], declaration);
+
+    NameId beginJ = nameTable.size();
+    if (J != I)
+    {
+        traversal.scopeScorer.incremental = true;
+        for (NameId k = beginI; k != beginJ; ++k)
+            nameTable[k].group = beginI;
+
+        for (uint32_t k = table.chunkBegin[J]; k != table.chunkBegin[J + 1]; ++k)
+            traversal.addName(table.strings[k], declaration);
+
+        for (NameId k = beginJ; k != nameTable.size(); ++k)
+            nameTable[k].group = beginJ;
+    }
+
+    vector<NameMatch> results;
+    traversal.scopeScorer.scoreNames(beginI, nameTable.size(), results);
+
+    vector<ShardTable::Match> matches(results.size());
+    for (size_t m = 0; m < results.size(); ++m)
+    {
+        NameId first  = results[m].first;
+        NameId second = results[m].second;
+
+        matches[m].first  = first < beginJ ? table.chunkBegin[I] + (first - beginI)
+                                           : table.chunkBegin[J] + (first - beginJ);
+        matches[m].second = second < beginJ ? table.chunkBegin[I] + (second - beginI)
+                                            : table.chunkBegin[J] + (second - beginJ);
+        matches[m].similarity = results[m].similarity;
+    }
+
+    if (ShardTable::writeBlock(tableFile, block, matches) == false)
+    {
+        fprintf(stderr, "Error: could not write the results of block %u\n", block);
+        return 1;
+    }
+
+    return 0;
+  }
+
+/**
+ * Merge the results of all the blocks of the ShardTable tableFile into the
+ * report of all the names of the traversal, as a single scope.
+ */
+int
+mergeShards(Traversal& traversal, const string& tableFile)
+  {
+    ShardTable table;
+    if (table.read(tableFile) == false)
+    {
+        fprintf(stderr, "Error: invalid shard table %s\n", tableFile.c_str());
+        return 1;
+    }
+
+    similarity_threshold = table.threshold;
+    similarity_metric    = table.metric;
+    pruningBounds.compute();
+
+    // The occurrences of each string.
+    NameTable& nameTable = traversal.nameTable;
+    vector<NameId> occurrenceStart(nameTable.numberOfStrings() + 1, 0);
+    for (NameId k = 0; k < nameTable.size(); ++k)
+        ++occurrenceStart[nameTable[k].stringId + 1];
+
+    for (NameId s = 0; s < nameTable.numberOfStrings(); ++s)
+        occurrenceStart[s + 1] += occurrenceStart[s];
+
+    vector<NameId> occurrences(nameTable.size());
+    vector<NameId> next(occurrenceStart.begin(), occurrenceStart.end() - 1);
+    for (NameId k = 0; k < nameTable.size(); ++k)
+        occurrences[next[nameTable[k].stringId]++] = k;
+
+    // The matches of each block spill as there are more than the
+    // traversal's matchBudget of them.
+    vector<NameMatch>       results;
+    vector<MatchSpill::Run> runs;
+    size_t                  spillMatches = traversal.matchBudget;
+    for (unsigned block = 0; block < table.blocks.size(); ++block)
+    {
+        vector<ShardTable::Match> matches;
+        if (ShardTable::readBlock(tableFile, block, matches) == false)
+        {
+            fprintf(stderr, "Error: no results for block %u of %s\n", block, tableFile.c_str());
+            return 1;
+        }
+
+        for (size_t m = 0; m < matches.size(); ++m)
+        {
+            if (matches[m].first >= table.strings.size() || matches[m].second >= table.strings.size())
+                continue;
+
+            NameId a = nameTable.lookup(table.strings[matches[m].first]);
+            NameId b = nameTable.lookup(table.strings[matches[m].second]);
+            if (a == NameTable::NoString || b == NameTable::NoString)
+                continue;
+
+            for (NameId x = occurrenceStart[a]; x != occurrenceStart[a + 1]; ++x)
+                for (NameId y = occurrenceStart[b]; y != occurrenceStart[b + 1]; ++y)
+                {
+                    NameId first  = min(occurrences[x], occurrences[y]);
+                    NameId second = max(occurrences[x], occurrences[y]);
+                    results.push_back(NameMatch(first, second, matches[m].similarity));
+                }
+
+            if (spillMatches > 0 && results.size() >= spillMatches)
+                traversal.matchSpill.write(results, runs);
+        }
+    }
+
+    // The occurrences of the same string match each other.
+    if (1.0 > similarity_threshold)
+    {
+        for (NameId s = 0; s < nameTable.numberOfStrings(); ++s)
+        {
+            for (NameId x = occurrenceStart[s]; x < occurrenceStart[s + 1]; ++x)
+                for (NameId y = x + 1; y < occurrenceStart[s + 1]; ++y)
+                {
+                    if (nameTable[occurrences[x]].size() > 0)
+                        results.push_back(NameMatch(occurrences[x], occurrences[y], 1.0));
+                }
+
+            if (spillMatches > 0 && results.size() >= spillMatches)
+                traversal.matchSpill.write(results, runs);
+        }
+    }
+
+    sort(results.begin(), results.end());
+
+    Declaration project;
+    project.kind = "SgProject";
+    traversal.reportScope(project, results, runs);
+    return 0;
+  }
+
+/**
+ * Print the statistics of the run (in stats_mode), and write them to the
+ * stats_file if any; \return false if that fails.
+ */
+bool
+reportStatistics(const Traversal& traversal)
+  {
+    if (stats_mode == false)
+    {
+        if (threshold_bins.empty() == false)
+            traversal.statistics.printThresholds(stderr);
+        return true;
+    }
+
+    traversal.statistics.print(stderr, traversal.numberOfNames());
+
+    if (stats_file.empty() == false && traversal.statistics.write(stats_file, traversal.numberOfNames()) == false)
+    {
+        fprintf(stderr, "Error: could not write the statistics to %s\n", stats_file.c_str());
+        return false;
+    }
+
+    return true;
+  }
+
+#ifdef COUNT_ALLOCATIONS
+/**
+ * The number of allocations by operator new so far, counted when built
+ * with -DCOUNT_ALLOCATIONS (as by make bench).  The replacements are not
+ * inlined, so the compiler does not take them for the library's.
+ */
+volatile uint64_t allocation_count = 0;
+
+__attribute__((noinline)) void*
+operator new(size_t size)
+  {
+    __sync_fetch_and_add(&allocation_count, 1);
+
+    void* memory = malloc(size > 0 ? size : 1);
+    if (memory == NULL)
+        throw bad_alloc();
+    return memory;
+  }
+
+__attribute__((noinline)) void*
+operator new[](size_t size)
+  {
+    return operator new(size);
+  }
+
+__attribute__((noinline)) void
+operator delete(void* memory) throw()
+  {
+    free(memory);
+  }
+
+__attribute__((noinline)) void
+operator delete[](void* memory) throw()
+  {
+    free(memory);
+  }
+#endif
+
+/**
+ * One measurement of runBenchmarks(): items (pairs of names, or names)
+ * processed in seconds, with the allocations made meanwhile and the peak
+ * resident set size of the process afterwards.
+ */
+class BenchmarkResult
+  {
+    public:
+      string   name;
+      string   unit;
+      uint64_t items;
+      double   seconds;
+      uint64_t allocations;
+      long     peakKilobytes;
+
+      double nanosecondsPerItem() const { return (items > 0) ? 1e9 * seconds / items : 0; }
+  };
+
+/**
+ * The measurements of runBenchmarks(), one start() and stop() around each.
+ */
+class Benchmarks
+  {
+    public:
+      void start(const string& name, const string& unit);
+      void stop(uint64_t items);
+
+      /**
+       * Print the results, with the change of the time per item from the
+       * same benchmarks of the baseline (if any).
+       */
+      void print(const map<string, double>& baseline) const;
+
+      /**
+       * Read the time per item of each benchmark written by write().
+       */
+      static bool readBaseline(const string& fileName, map<string, double>& baseline);
+
+      bool write(const string& fileName) const;
+
+      vector<BenchmarkResult> results;
+
+    private:
+      static uint64_t allocations();
+
+      BenchmarkResult current;
+  };
+
+uint64_t
+Benchmarks::allocations()
+  {
+#ifdef COUNT_ALLOCATIONS
+    return allocation_count;
+#else
+    return 0;
+#endif
+  }
+
+void
+Benchmarks::start(const string& name, const string& unit)
+  {
+    current.name        = name;
+    current.unit        = unit;
+    current.allocations = allocations();
+    current.seconds     = secondsNow();
+  }
+
+void
+Benchmarks::stop(uint64_t items)
+  {
+    current.seconds     = secondsNow() - current.seconds;
+    current.allocations = allocations() - current.allocations;
+    current.items       = items;
+
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    current.peakKilobytes = usage.ru_maxrss;
+
+    results.push_back(current);
+  }
+
+void
+Benchmarks::print(const map<string, double>& baseline) const
+  {
+    printf("%-44s %10s %-6s %10s %12s %10s %10s %9s\n",
+           "benchmark", "items", "", "ns/item", "items/s", "allocs", "peak KiB", "baseline");
+
+    for (size_t k = 0; k < results.size(); ++k)
+    {
+        const BenchmarkResult& result = results[k];
+
+        char change[16] = "-";
+        map<string, double>::const_iterator before = baseline.find(result.name);
+        if (before != baseline.end() && before->second > 0)
+            snprintf(change, sizeof(change), "%+.1f%%", 100 * (result.nanosecondsPerItem() / before->second - 1));
+
+        printf("%-44s %10lu %-6s %10.1f %12.0f %10lu %10ld %9s\n",
+               result.name.c_str(), (unsigned long) result.items, result.unit.c_str(),
+               result.nanosecondsPerItem(), (result.seconds > 0) ? result.items / result.seconds : 0,
+               (unsigned long) result.allocations, result.peakKilobytes, change);
+    }
+
+#ifndef COUNT_ALLOCATIONS
+    printf("(allocations are only counted when built with -DCOUNT_ALLOCATIONS)\n");
+#endif
+  }
+
+bool
+Benchmarks::readBaseline(const string& fileName, map<string, double>& baseline)
+  {
+    FILE* file = fopen(fileName.c_str(), "r");
+    if (file == NULL)
+        return false;
+
+    char name[256];
+    double nanoseconds;
+    while (fscanf(file, "%255s %lf%*[^\n]", name, &nanoseconds) == 2)
+        baseline[name] = nanoseconds;
+
+    fclose(file);
+    return true;
+  }
+
+bool
+Benchmarks::write(const string& fileName) const
+  {
+    FILE* file = fopen(fileName.c_str(), "w");
+    if (file == NULL)
+        return false;
+
+    // The name and the time per item first, the other columns for reference.
+    for (size_t k = 0; k < results.size(); ++k)
+    {
+        const BenchmarkResult& result = results[k];
+        fprintf(file, "%s %.3f %lu %s %.6f %lu %ld\n",
+                result.name.c_str(), result.nanosecondsPerItem(), (unsigned long) result.items,
+                result.unit.c_str(), result.seconds, (unsigned long) result.allocations,
+                result.peakKilobytes);
+    }
+
+    return fclose(file) == 0;
+  }
+
+/**
+ * \return count pseudo-random names of the given length: all variations
+ * of the same name (a few characters changed) if similar, otherwise
+ * unrelated to each other.
+ */
+vector<string>
+benchmarkNames(size_t count, size_t length, bool similar, uint64_t seed)
+  {
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz_";
+
+    string base(length, 'a');
+    for (size_t c = 0; c < length; ++c)
+        base[c] = alphabet[(seed = mixBits(seed)) % 27];
+
+    vector<string> names;
+    for (size_t k = 0; k < count; ++k)
+    {
+        string name = base;
+        size_t changes = similar ? length / 8 + 1 : length;
+        for (size_t c = 0; c < changes; ++c)
+        {
+            seed = mixBits(seed);
+            name[similar ? (seed >> 32) % length : c] = alphabet[seed % 27];
+        }
+        names.push_back(name);
+    }
+
+    return names;
+  }
+
+/**
+ * Time the similarity kernels on names of each length class, all pairs of
+ * names either similar or not.
+ */
+void
+benchmarkKernels(Benchmarks& benchmarks)
+  {
+    static const size_t lengths[] = { 6, 12, 24, 48, 96 };
+    static const char*  metrics[] = { "lcs", "ro", "levenshtein" };
+    const size_t count = 64;
+
+    SimilarityKernel& kernel = SimilarityKernel::threadLocal();
+    volatile float sink = 0;
+
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); ++l)
+    {
+        for (int similar = 0; similar < 2; ++similar)
+        {
+            size_t length = lengths[l];
+            vector<string> names = benchmarkNames(count, length, similar, length * 2 + similar);
 
-    return lenLCS /= len1;
-  }
+            // About the same number of cells of the dynamic programming table
+            // for each class.
+            size_t rounds = max((size_t) 1, ((size_t) 1 << 26) / (length * length * count * count));
+            uint64_t pairs = (uint64_t) rounds * count * count;
 
-/**
- * \return A pointer to the Longest Common Sequence in str1 and str2
- * Assumes str1 and str2 point to 2 null terminated array of char
- */
-char*
-longestCommonSubstring( const char *str1, const char *str2)
-  {
-    static char lcs[MAX_LCS];
-    int i, r, c, len1 = (int)strlen(str1), len2=(int)strlen(str2);
-    unsigned **align;
+            char suffix[32];
+            snprintf(suffix, sizeof(suffix), "/%u/%s", (unsigned) length, similar ? "similar" : "unrelated");
 
-    if( len1==0 || len2==0)
-        return 0;
+            Metric metric = similarity_metric;
+            for (size_t m = 0; m < NumberOfMetrics; ++m)
+            {
+                similarity_metric = (Metric) m;
 
-    align = (unsigned **)calloc( len2+1, sizeof(unsigned *));
+                benchmarks.start(string("similarityMetric-") + metrics[m] + suffix, "pairs");
+                for (size_t r = 0; r < rounds; ++r)
+                    for (size_t i = 0; i < count; ++i)
+                        for (size_t j = 0; j < count; ++j)
+                            sink = sink + similarityMetric(names[i].c_str(), names[j].c_str());
+                benchmarks.stop(pairs);
 
-    for( r=0; r<=len2; ++r)
-        align[r]=(unsigned *)calloc( len1+1, sizeof(unsigned));
+                benchmarks.start(string("similarityAtLeast-") + metrics[m] + suffix, "pairs");
+                for (size_t r = 0; r < rounds; ++r)
+                    for (size_t i = 0; i < count; ++i)
+                        for (size_t j = 0; j < count; ++j)
+                            sink = sink + similarityAtLeast(names[i].c_str(), names[j].c_str(), similarity_threshold);
+                benchmarks.stop(pairs);
+            }
+            similarity_metric = metric;
 
-    for(r=1; r<=len2; ++r)
-        for(c=1; c<=len1; ++c)
-             if( str1[c-1] == str2[r-1])
-                  align[r][c]=align[r-1][c-1]+1;
-               else
-                  align[r][c]=align[r-1][c]>=align[r][c-1]?align[r-1][c]:align[r][c-1];
+            CandidateBlock block;
+            for (size_t j = 0; j < count; ++j)
+                block.add(names[j].c_str(), (uint32_t) length);
+            block.pack();
 
-    for (r = len2, c = len1, i = align[r][c], lcs[i]='\0'; i>0 && r>0 && c>0; i=align[r][c])
-      {
-        if ( align[r-1][c] == (unsigned) i)
-             --r;
-          else
-           {
-             if ( align[r][c-1] == (unsigned) i)
-                  --c;
-               else
+            uint64_t matches[(count + 63) / 64];
+            benchmarks.start(string("matchBatch") + suffix, "pairs");
+            for (size_t r = 0; r < rounds; ++r)
+                for (size_t i = 0; i < count; ++i)
                 {
-               // if (align[r-1][c-1] == i-1)
-                  if (align[r-1][c-1] == (unsigned) i-1)
-                     {
-                       lcs[i-1] = str2[--r];
-                       --c;
-                     }
+                    kernel.matchBatch(names[i].c_str(), length, block, 0, count, similarity_threshold, matches);
+                    sink = sink + matches[0];
                 }
-           }
-      }
+            benchmarks.stop(pairs);
 
-    for (r = len2; r >= 0; --r)
-        free (align[r]);
+            // Reconstructing the subsequence is only done for the matches.
+            size_t lcsRounds = rounds / 16 + 1;
+            string lcs;
+            benchmarks.start(string("longestCommonSubstring") + suffix, "pairs");
+            for (size_t r = 0; r < lcsRounds; ++r)
+                for (size_t i = 0; i < count; ++i)
+                    for (size_t j = 0; j < count; ++j)
+                    {
+                        lcs.clear();
+                        longestCommonSubstring(names[i].c_str(), names[j].c_str(), lcs);
+                        sink = sink + lcs.size();
+                    }
+            benchmarks.stop((uint64_t) lcsRounds * count * count);
+        }
+    }
+  }
 
-    free (align);
+/**
+ * \return name, or name with a numbered suffix if it is already declared,
+ * adding it to the declared names.
+ */
+string
+declareBenchmarkName(const string& name, set<string>& declared)
+  {
+    string unique = name;
+    for (unsigned k = 1; declared.insert(unique).second == false; ++k)
+    {
+        char suffix[16];
+        snprintf(suffix, sizeof(suffix), "_%u", k);
+        unique = name + suffix;
+    }
 
-    return lcs;
+    return unique;
   }
 
 /**
- * This structure is used to hold names and their links to the AST.
- * When matches are found this allows for more information to be 
- * output about where the names came from.  Identical names may
- * match and in this case the information as to how they are used
- * and what nested scope they came from, etc.
+ * Write the scope of a synthetic translation unit to file: breadth
+ * variables, a function with parameters and nested blocks, and (above the
+ * given depth) breadth nested namespaces.  The names come from a small
+ * vocabulary, so that many of them are similar, but each is only declared
+ * once in its scope.
  */
-class NameStructure
+void
+writeBenchmarkScope(FILE* file, unsigned depth, unsigned breadth, uint64_t& seed)
   {
-    public:
-      string  name;
-      SgNode* associatedNode;
+    static const char* words[] =
+      {
+        "buffer", "count", "index", "value", "size", "length", "offset", "node",
+        "table", "entry", "name", "state", "total", "next", "first", "result"
+      };
 
-      NameStructure(string name, SgNode* associatedNode = NULL)
-        : name(name),
-          associatedNode(associatedNode)
+    // The variables and functions of the scope; the first name is also
+    // the local variable of the function, the others its parameters.
+    set<string> declared;
+    string names[3];
+    for (unsigned k = 0; k < breadth; ++k)
+    {
+        set<string> function;
+        for (size_t n = 0; n < 3; ++n)
         {
-          ROSE_ASSERT(associatedNode != NULL);
+            seed = mixBits(seed);
+            char number[16];
+            snprintf(number, sizeof(number), "%u", (unsigned) ((seed >> 16) % 100));
+            names[n] = string(words[seed % 16]) + "_" + words[(seed >> 8) % 16] + number;
+
+            names[n] = declareBenchmarkName(names[n], n == 0 ? declared : function);
+            if (n == 0)
+                function.insert(names[0]);
         }
 
-      NameStructure(const NameStructure & X)
-        : name(X.name),
-          associatedNode(X.associatedNode)
-        {}
+        char suffix[16];
+        snprintf(suffix, sizeof(suffix), "_%u", k);
+        string functionName = declareBenchmarkName(names[0] + suffix, declared);
 
-      size_t size() { return name.size(); }
-      const char* c_str() { return name.c_str(); }
-  };
-typedef NameStructure NameStructureType;
+        fprintf(file, "int %s;\n", names[0].c_str());
+        fprintf(file, "int %s(int %s, int %s)\n{\n  int %s;\n  { int %s_; int %s_; }\n}\n",
+                functionName.c_str(), names[1].c_str(), names[2].c_str(),
+                names[0].c_str(), names[1].c_str(), names[2].c_str());
+    }
 
-/**
- *  This is used to pass context down in the AST traversal (but not required).
- */
-class InheritedAttribute
-  {
-  };
+    if (depth > 0)
+    {
+        for (unsigned b = 0; b < breadth; ++b)
+        {
+            fprintf(file, "namespace ns_%u_%u {\n", depth, b);
+            writeBenchmarkScope(file, depth - 1, breadth, seed);
+            fprintf(file, "}\n");
+        }
+    }
+  }
 
 /**
- * This is used to pass information up in the AST traversal.
+ * Time the extraction and scoring of the names of a project (without
+ * printing the report), parsing it with argvList.
  */
-class SynthesizedAttribute
+void
+benchmarkProject(Benchmarks& benchmarks, const string& name, const vector<string>& argvList)
   {
-    public:
-      vector<NameStructureType> nameList;
-  };
+    benchmarks.start(name + "/frontend", "files");
+    SgProject* project = new SgProject(argvList);
+    benchmarks.stop(project->numberOfFiles());
+
+    Traversal traversal;
+    string report;
+    traversal.reportBuffer = &report;
+
+    benchmarks.start(name + "/traversal", "names");
+    extractNames(project, traversal);
+    benchmarks.stop(traversal.nameTable.size());
+
+    benchmarks.start(name + "/scoring", "names");
+    traversal.scoreScopes();
+    benchmarks.stop(traversal.nameTable.size());
+  }
 
 /**
- * TODO:
+ * Time the similarity kernels, the traversal of a synthetic scope tree of
+ * benchmark_depth nested levels of benchmark_breadth scopes each, and the
+ * project of the input files (if any), and compare the times to the
+ * benchmark_baseline (or write it if there is none yet).
  */
-class Traversal :
-  public SgTopDownBottomUpProcessing<InheritedAttribute, SynthesizedAttribute>
+int
+runBenchmarks(const vector<string>& argvList)
   {
-    public:
-      //== Functions required to support the AST traversal:
+    Benchmarks benchmarks;
 
-      InheritedAttribute
-      evaluateInheritedAttribute(
-          SgNode* astNode,
-          InheritedAttribute inheritedAttribute);
+    benchmarkKernels(benchmarks);
 
-      SynthesizedAttribute
-      evaluateSynthesizedAttribute(
-          SgNode* astNode,
-          InheritedAttribute inheritedAttribute,
-          SubTreeSynthesizedAttributes synthesizedAttributeList );
+    char treeFile[] = "/tmp/uvn_benchmarkXXXXXX.C";
+    int descriptor = mkstemps(treeFile, 2);
+    FILE* file = (descriptor < 0) ? NULL : fdopen(descriptor, "w");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Error: could not write the synthetic scope tree\n");
+        return 1;
+    }
 
-      /**
-       *  Extract the name and add it to the list/set.
-       */
-      void processNode (SgNode* n, SynthesizedAttribute& synthesizedAttribute);
+    uint64_t seed = 1;
+    writeBenchmarkScope(file, benchmark_depth, benchmark_breadth, seed);
+    fclose(file);
 
-      /**
-       *  Match names for similarity (applies similarity metric)
-       */
-      void processNames( SgNode* n, SynthesizedAttribute & synthesizedAttribute );
-  };
+    char treeName[64];
+    snprintf(treeName, sizeof(treeName), "tree-%ux%u", benchmark_depth, benchmark_breadth);
+
+    vector<string> treeArguments;
+    treeArguments.push_back(argvList[0]);
+    treeArguments.push_back(treeFile);
+    benchmarkProject(benchmarks, treeName, treeArguments);
+    unlink(treeFile);
+
+    bool inputs = false;
+    for (size_t i = 1; i < argvList.size(); ++i)
+        inputs = inputs || isSourceFileName(argvList[i]);
+
+    if (inputs)
+        benchmarkProject(benchmarks, "end-to-end", argvList);
+
+    map<string, double> baseline;
+    bool compared = benchmark_baseline.empty() == false && Benchmarks::readBaseline(benchmark_baseline, baseline);
+
+    benchmarks.print(baseline);
+
+    if (benchmark_baseline.empty() == false && compared == false)
+    {
+        if (benchmarks.write(benchmark_baseline) == false)
+        {
+            fprintf(stderr, "Error: could not write the baseline %s\n", benchmark_baseline.c_str());
+            return 1;
+        }
+        printf("(baseline written to %s)\n", benchmark_baseline.c_str());
+    }
+
+    return 0;
+  }
 
+/**
+ * Print the occurrences of the results of a query in scope, a line each.
+ */
 void
-Traversal::processNode(SgNode* n, SynthesizedAttribute& synthesizedAttribute )
+printQueryResults(const NameQuery& query, const string& scope, const vector<NameQuery::Result>& results)
   {
-    // Look for names of functions
-    SgFunctionDeclaration* functionDeclaration = isSgFunctionDeclaration(n);
-    if (functionDeclaration != NULL)
+    for (size_t r = 0; r < results.size(); ++r)
     {
-        string name = functionDeclaration->get_name().str();
+        NameId stringId = results[r].stringId;
+        for (NameId k = query.occurrenceStart[stringId]; k != query.occurrenceStart[stringId + 1]; ++k)
+        {
+            const NameStructureType& name = query.nameTable[query.occurrences[k]];
+            const Declaration& declaration = name.declaration;
 
-        #if DEBUG > 3
-          SgFunctionDefinition* functionDefinition =
-              functionDeclaration->get_definition();
-          if (functionDefinition != NULL)
-              printf ("SgFunctionDefinition: %s \n",name.c_str());
-          else
-              printf ("SgFunctionDeclaration: %s \n",name.c_str());
-        #endif
+            if (strncmp(declaration.file, scope.c_str(), scope.size()) != 0)
+                continue;
 
-        synthesizedAttribute.nameList.push_back(
-            NameStructureType(name,n));
-        // nameSet.insert(name);
+            printf("%.3f %s %s:%u %s\n", results[r].similarity, name.c_str(),
+                   declaration.file, declaration.line, declaration.kind);
+        }
     }
+  }
 
-    SgInitializedName* initializedName = isSgInitializedName(n);
-    if (initializedName != NULL)
-    {
-        string name = initializedName->get_name().str();
-
-        #if DEBUG > 3
-          printf ("SgInitializedName: %s \n",name.c_str());
-        #endif
+/**
+ * Load the names of the query_index once, then answer the queries read from
+ * standard input, a line each, until it ends (or "quit"):
+ *
+ *   top K NAME [in SCOPE]    the K names most similar to NAME
+ *   above T NAME [in SCOPE]  the names more than T similar to NAME
+ *   compare NAME1 NAME2      the similarity of the two names, and one of
+ *                            their longest common subsequences
+ *
+ * where SCOPE only keeps the names declared in the files whose path starts
+ * with it.  Each answer is a line per name (its similarity, name, location
+ * and the class name of its declaration), then an empty line.
+ */
+int
+runQueries()
+  {
+    NameQuery query;
 
-        synthesizedAttribute.nameList.push_back(
-            NameStructureType(name,n));
-        // nameSet.insert(name);
+    double start = secondsNow();
+    if (query.load(query_index) == false)
+    {
+        fprintf(stderr, "Error: could not load the index %s\n", query_index.c_str());
+        return 1;
     }
 
-    SgNamespaceDeclarationStatement* namespaceDeclaration = isSgNamespaceDeclarationStatement(n);
-    if (namespaceDeclaration != NULL)
+    fprintf(stderr, "%u names loaded in %.3f s\n", (unsigned) query.nameTable.size(), secondsNow() - start);
+
+    char line[4096];
+    while (fgets(line, sizeof(line), stdin) != NULL)
     {
-        string name = namespaceDeclaration->get_name().str();
+        vector<string> words;
+        for (char* word = strtok(line, " \t\r\n"); word != NULL; word = strtok(NULL, " \t\r\n"))
+            words.push_back(word);
 
-        #if DEBUG > 3
-          printf ("SgNamespaceDeclaration: %s \n",name.c_str());
-        #endif
+        if (words.empty())
+            continue;
+        if (words[0] == "quit")
+            break;
 
-        synthesizedAttribute.nameList.push_back(
-            NameStructureType(name,n));
-        // nameSet.insert(name);
+        string scope;
+        if (words.size() == 5 && words[3] == "in")
+        {
+            scope = words[4];
+            words.resize(3);
+        }
+
+        vector<NameQuery::Result> results;
+        if (words.size() == 3 && words[0] == "top" && atoi(words[1].c_str()) > 0)
+        {
+            query.find(words[2], scope, 0, atoi(words[1].c_str()), results);
+            printQueryResults(query, scope, results);
+        }
+        else if (words.size() == 3 && words[0] == "above")
+        {
+            query.find(words[2], scope, (float) atof(words[1].c_str()), 0, results);
+            printQueryResults(query, scope, results);
+        }
+        else if (words.size() == 3 && words[0] == "compare")
+        {
+            string lcs;
+            longestCommonSubstring(words[1].c_str(), words[2].c_str(), lcs);
+            printf("%.3f %s %s %s\n", similarityMetric(words[1].c_str(), words[2].c_str()),
+                   words[1].c_str(), words[2].c_str(), lcs.c_str());
+        }
+        else
+        {
+            printf("error: expected top K NAME, above T NAME (either followed by in SCOPE) or compare NAME1 NAME2\n");
+        }
+
+        printf("\n");
+        fflush(stdout);
     }
+
+    return 0;
   }
 
-void
-Traversal::processNames(SgNode* n, SynthesizedAttribute& synthesizedAttribute )
+int
+main(int argc, char * argv[])
   {
-    // Now process the list of names for matches
+    vector<string> argvList(argv, argv + argc);
+    processCommandLine(argvList);
+    pruningBounds.compute();
 
-    // Matching names (eventually we have to map this back to the AST)
-    vector< pair<NameStructureType,NameStructureType> > results;
+    if (benchmark_mode)
+        return runBenchmarks(argvList);
 
-    SgScopeStatement* scopeStatement = isSgScopeStatement(n);
-    ROSE_ASSERT(scopeStatement != NULL);
+    if (query_index.empty() == false)
+        return runQueries();
 
-    int i_index = 0;
-    vector<NameStructureType>::iterator i;
-    for (i = synthesizedAttribute.nameList.begin();
-         i != synthesizedAttribute.nameList.end();
-         ++i)
+    // Only the runs producing reports are indexed (or pipelined).
+    if (emit_names_file.empty() == false || name_stream_files.empty() == false)
     {
-        ++i_index;
+        index_file.clear();
+        pipeline_mode = false;
+    }
+
+    // The matches of the files reused from an index would not be counted.
+    if (threshold_bins.empty() == false)
+        index_file.clear();
 
-        // size_t i_length = i->size();
+    // With an index, the input files that did not change are not parsed.
+    SimilarityIndex index;
+    uint64_t configuration = 0;
 
-        int j_index = 0;
-        vector<NameStructureType>::iterator j;
-        for (j = synthesizedAttribute.nameList.begin();
-             j != synthesizedAttribute.nameList.end();
-             ++j)
+    vector<string> inputs;
+    vector<const SimilarityIndex::Entry*> replayed;
+    vector<IndexRecord*> records;
+
+    if (index_file.empty() == false || pipeline_mode)
+    {
+        if (index_file.empty() == false)
         {
-            ++j_index;
+            configuration = configurationHash(argvList);
+            index.load(index_file, configuration);
+        }
 
-            // We only want to visit the lower triangular part of the n^2
-            // matchings of names to each other.  This reduces the number of
-            // comparisions required.
-            if (j_index <= i_index)
+        vector<string>::iterator i = argvList.begin() + 1;
+        while (i != argvList.end())
+        {
+            if (isSourceFileName(*i) == false)
             {
-                #if DEBUG > 1
-                printf ("Skipping case of "
-                        "j_index = %d <= i_index = %d (%s,%s) \n",
-                        j_index,
-                        i_index,
-                        i->c_str(),
-                        j->c_str());
-                #endif
-
+                ++i;
                 continue;
             }
 
-            #if DEBUG > 2
-            printf ("Evaluating greatestPossibleSimilarity of "
-                    "j_index = %d <= i_index = %d (%s,%s) \n",
-                    j_index,
-                    i_index,
-                    i->c_str(),
-                    j->c_str());
-            #endif
+            inputs.push_back(*i);
+            replayed.push_back(index.find(*i));
+            records.push_back(NULL);
 
-            size_t i_length = i->size();
-            size_t j_length = j->size();
+            if (replayed.back() != NULL)
+                i = argvList.erase(i);
+            else
+                ++i;
+        }
+    }
 
-            float greatestPossibleSimilarity =
-                ((float)j_length) / ((float)i_length);
+    // Define the traversal
+    Traversal myTraversal;
 
-            if (greatestPossibleSimilarity > 1.0)
-            {
-                greatestPossibleSimilarity =
-                    1.0 / greatestPossibleSimilarity;
-            }
+    NameStream nameStream;
+    if (emit_names_file.empty() == false)
+    {
+        if (nameStream.open(emit_names_file) == false)
+        {
+            fprintf(stderr, "Error: could not write the names to %s\n", emit_names_file.c_str());
+            return 1;
+        }
+        myTraversal.nameStream = &nameStream;
+    }
 
-            if (greatestPossibleSimilarity < similarity_threshold)
-            {
-                #if DEBUG > 1
-                printf ("Skipping case of "
-                        "j_index = %d i_index = %d (%s,%s) "
-                        "greatestPossibleSimilarity = %f \n",
-                        j_index,
-                        i_index,
-                        i->c_str(),
-                        j->c_str(),
-                        greatestPossibleSimilarity);
-                #endif
+    // Only emitting the names, or planning and scoring shards, reports nothing.
+    bool reporting = emit_names_file.empty() && (shard_phase == NoShards || shard_phase == MergeShards);
+    if (reporting && reportWriter.open(output_file) == false)
+    {
+        fprintf(stderr, "Error: could not write the report to %s\n", output_file.c_str());
+        return 1;
+    }
 
-                continue;
+    if (shard_phase != NoShards)
+    {
+        // Only the names themselves matter here, not their scopes.
+        for (size_t k = 0; k < name_stream_files.size(); ++k)
+        {
+            if (myTraversal.replayNames(name_stream_files[k], false) == false)
+            {
+                fprintf(stderr, "Error: invalid names in %s\n", name_stream_files[k].c_str());
+                return 1;
             }
+        }
 
-            #if DEBUG > 2
-              printf ("Evaluating similarityMetric of"
-                      "j_index = %d <= i_index = %d (%s,%s) \n",
-                      j_index,
-                      i_index,
-                      i->c_str(),
-                      j->c_str());
-            #endif
+        if (shard_phase == PlanShards)
+            return planShards(myTraversal, shard_table);
+        else if (shard_phase == ScoreShard)
+            return scoreShard(myTraversal, shard_table, shard_block);
 
-            float similarity =
-                similarityMetric(
-                    i->c_str(),
-                    j->c_str());
+        int status = mergeShards(myTraversal, shard_table);
+        if (reportWriter.close() == false)
+        {
+            fprintf(stderr, "Error: could not write the report to %s\n", output_file.c_str());
+            return 1;
+        }
+        return reportStatistics(myTraversal) ? status : 1;
+    }
 
-            if (similarity > similarity_threshold)
+    if (name_stream_files.empty() == false)
+    {
+        // The names were already extracted.
+        for (size_t k = 0; k < name_stream_files.size(); ++k)
+        {
+            if (myTraversal.replayNames(name_stream_files[k]) == false)
             {
-                string lcs = longestCommonSubstring(i->c_str(), j->c_str());
-
-                #if DEBUG > 1
-                printf("\n\"%s\" and \"%s\" are %3.0f%% similar.\n"
-                       "One of the longest common sequences is \"%s\".\n\n",
-                        i->c_str(),
-                        j->c_str(),
-                        similarity*100,
-                        lcs.c_str());
-                #endif
-
-                results.push_back(
-                    pair<NameStructureType, NameStructureType> (*i, *j));
+                fprintf(stderr, "Error: invalid names in %s\n", name_stream_files[k].c_str());
+                return 1;
             }
         }
-    }// for each synthesized attribute
-
-    // Output the resulting matches of any non-empty list of results
-    if (results.empty() == false)
+    }
+    else if (inputs.empty() ||
+             find(replayed.begin(), replayed.end(), (const SimilarityIndex::Entry*) NULL) != replayed.end())
     {
-        printf ("\n\n*******************************************************\n");
-        printf ("Processing matches of name in "
-                "scope = %p = %s = %s \n",
-                scopeStatement,
-                scopeStatement->class_name().c_str(),
-                SageInterface::get_name(scopeStatement).c_str());
+        // The comments and directives have no names.
+        if (fast_extraction)
+            argvList.insert(argvList.begin() + 1, "-rose:skip_commentsAndDirectives");
 
-        vector< pair<NameStructureType, NameStructureType> >::iterator i;
-        for (i = results.begin(); i != results.end(); ++i)
+        for (size_t k = 0; k < inputs.size(); ++k)
         {
-            // Output the matching names
-
-            SgNode* firstNode  = i->first.associatedNode;
-            ROSE_ASSERT(firstNode != NULL);
-
-            SgNode* secondNode = i->second.associatedNode;
-            ROSE_ASSERT(secondNode != NULL);
-
-            float similarity =
-            similarityMetric(i->first.c_str(), i->second.c_str());
-            int similarityPercentage = 100 * similarity;
+            char path[PATH_MAX];
+            if (index_file.empty() == false && replayed[k] == NULL
+                && realpath(inputs[k].c_str(), path) != NULL)
+            {
+                records[k] = new IndexRecord(inputs[k]);
+                myTraversal.indexRecords[path] = records[k];
+            }
+        }
 
-            printf ("[%d\% similarity]\n"
-                    "\t%s:%s:%s\n"
-                    "\t%s:%s:%s\n",
-                    similarityPercentage,
-                    i->first.associatedNode->class_name().c_str(),
-                    SageInterface::get_name(
-                        i->first.associatedNode).c_str(),
-                        i->first.c_str(),
-                    i->second.associatedNode->class_name().c_str(),
-                    SageInterface::get_name(
-                        i->second.associatedNode).c_str(),
-                        i->second.c_str());
+        if (pipeline_mode)
+        {
+            vector<string>      parsed;
+            vector<IndexRecord*> parsedRecords;
+            for (size_t k = 0; k < inputs.size(); ++k)
+            {
+                if (replayed[k] == NULL)
+                {
+                    parsed.push_back(inputs[k]);
+                    parsedRecords.push_back(records[k]);
+                }
+            }
 
-            printf ("     %s:%s on line %d in file %s \n",
-                    firstNode->class_name().c_str(),
-                    SageInterface::get_name(firstNode).c_str(),
-                    firstNode->get_file_info()->get_line(),
-                    firstNode->get_file_info()->get_filename());
+            if (runPipeline(argvList, parsed, parsedRecords, myTraversal) == false)
+                return 1;
+        }
+        else
+        {
+            double start = secondsNow();
+            SgProject* project = new SgProject(argvList);
+            myTraversal.statistics.seconds[RunStatistics::FrontendPhase] += secondsNow() - start;
 
-            printf ("     %s:%s on line %d in file %s \n",
-                    secondNode->class_name().c_str(),
-                    SageInterface::get_name(secondNode).c_str(),
-                    secondNode->get_file_info()->get_line(),
-                    secondNode->get_file_info()->get_filename());
+            extractNames(project, myTraversal);
 
-            printf ("\n");
+            // The names are all the scoring needs of the AST.
+            SageInterface::deleteAST(project);
+            myTraversal.scoreScopes();
         }
-
-        printf ("******************************************************* \n\n");
     }
-  }
-
 
-InheritedAttribute
-Traversal::evaluateInheritedAttribute (
-    SgNode* astNode,
-    InheritedAttribute inheritedAttribute)
-  {
-    if (isSgScopeStatement(astNode) != NULL)
+    if (index_file.empty() == false)
     {
-        // Build a new inherited attribute.
-        return InheritedAttribute();
-    }
+        double start = secondsNow();
 
-    return inheritedAttribute;
-  }
+        // The reports of the input files, in order.
+        vector<const SimilarityIndex::Entry*> reused;
+        for (size_t k = 0; k < inputs.size(); ++k)
+        {
+            if (replayed[k] != NULL)
+            {
+                reportWriter.write(replayed[k]->report, replayed[k]->reportSize);
+                reused.push_back(replayed[k]);
+            }
+            else if (records[k] != NULL)
+            {
+                reportWriter.write(records[k]->report);
+            }
+        }
 
-SynthesizedAttribute
-Traversal::evaluateSynthesizedAttribute (
-     SgNode* astNode,
-     InheritedAttribute inheritedAttribute,
-     SynthesizedAttributesList childAttributes )
-  {
-    SynthesizedAttribute result;
+        myTraversal.statistics.seconds[RunStatistics::OutputPhase] += secondsNow() - start;
 
-    #if 1
-    // Accumulate the names in the children into the names at the parent (current node).
-    SynthesizedAttributesList::iterator i;
-    for (i = childAttributes.begin(); i != childAttributes.end(); ++i)
-    {
-        vector<NameStructureType>::iterator n;
-        for (n = i->nameList.begin(); n != i->nameList.end(); ++n)
+        records.erase(remove(records.begin(), records.end(), (IndexRecord*) NULL), records.end());
+
+        // Beyond the files of their ASTs, the input files depend on every
+        // file they include.
+        vector<string> includePaths;
+        for (size_t k = 1; k < argvList.size(); ++k)
         {
-            result.nameList.push_back(*n);
+            if (argvList[k] == "-I" && k + 1 < argvList.size())
+                includePaths.push_back(argvList[++k]);
+            else if (argvList[k].compare(0, 2, "-I") == 0 && argvList[k].size() > 2)
+                includePaths.push_back(argvList[k].substr(2));
         }
-    }
-    #endif
-
-    if (isSgScopeStatement(astNode) != NULL)
-    {
-        // Now process the collected names.
-        processNames(astNode, result);
-    }
-    else
-    {
-        processNode(astNode,result);
-    }
 
-    return result;
-  }
+        for (size_t k = 0; k < records.size(); ++k)
+            addIncludedFiles(records[k]->path, includePaths, records[k]->dependencies);
 
+        if (index.write(index_file, configuration, reused, records) == false)
+            fprintf(stderr, "Warning: could not write the index %s\n", index_file.c_str());
 
-int
-main(int argc, char * argv[])
-  {
-    SgProject* project = new SgProject(argc, argv);
+        for (size_t k = 0; k < records.size(); ++k)
+            delete records[k];
+    }
 
-    // Build the inherited attribute
-    InheritedAttribute inheritedAttribute;
+    double start = secondsNow();
+    if (reportWriter.close() == false)
+    {
+        fprintf(stderr, "Error: could not write the report to %s\n", output_file.c_str());
+        return 1;
+    }
+    myTraversal.statistics.seconds[RunStatistics::OutputPhase] += secondsNow() - start;
 
-    // Define the traversal
-    Traversal myTraversal;
+    if (reportStatistics(myTraversal) == false)
+        return 1;
 
-    // Call the traversal starting at the project (root) node of the AST
-    #if 0
-    // For testing this just traverses the named input file (excluding header files).
-    myTraversal.traverseInputFiles(project,inheritedAttribute);
-    #else
-    // For more common use this traverses the input file and all of its header files.
-    myTraversal.traverse(project,inheritedAttribute);
-    #endif
+    if (nameStream.close() == false)
+    {
+        fprintf(stderr, "Error: could not write the names to %s\n", emit_names_file.c_str());
+        return 1;
+    }
 
     //cout << "Generating DOT...(for debugging)\n";
     //generateDOT( *project );
     //cout << "Done with DOT\n";
 
-    // Interactively test the string similarity support.
-    #if 0
-    #define MAX_STR	256
-
-    char str1[MAX_STR], str2[MAX_STR], dump;
-    printf("Type the 2 strings to compare.\nTo finish leave first string blank.\n");
-    while(scanf("%[^\n]", str1) !=0 )
-      {
-        scanf("\n%[^\n]%c", str2, &dump);
-        printf("\n\"%s\" and \"%s\" are %3.0f%% similar.\nOne of the longest common sequences is \"%s\".\n\n", str1, str2,similarityMetric(str1, str2)*100, longestCommonSubstring(str1, str2));
-     }
-    #endif
-
     // backend(project);
     return 0;
   }